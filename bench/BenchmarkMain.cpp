@@ -0,0 +1,8 @@
+/*
+ * Runs every benchmark in this directory. Build and run with `make bench`,
+ * pass --benchmark_filter=<regex> to only run some of them.
+ */
+
+#include <benchmark/benchmark.h>
+
+BENCHMARK_MAIN();
@@ -0,0 +1,121 @@
+#include "BenchmarkUtils.hpp"
+#include "global.hpp"
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <random>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+static std::atomic<size_t> allocations{0};
+
+// Count every allocation made with new. The other forms of new and delete all
+// call these
+void *operator new(size_t size) {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  void *memory = malloc(size == 0 ? 1 : size);
+  if (memory == NULL) {
+    throw std::bad_alloc();
+  }
+  return memory;
+}
+
+void *operator new[](size_t size) { return operator new(size); }
+void operator delete(void *memory) noexcept { free(memory); }
+void operator delete[](void *memory) noexcept { free(memory); }
+void operator delete(void *memory, size_t) noexcept { free(memory); }
+void operator delete[](void *memory, size_t) noexcept { free(memory); }
+
+size_t allocationCount() {
+  return allocations.load(std::memory_order_relaxed);
+}
+
+void makeTestImage(std::vector<PixelSorter_Pixel_t> &pixels, int width,
+                   int height, bool noise) {
+  std::mt19937 random(1);
+  pixels.resize((size_t)width * height);
+  for (int y = 0; y < height; y++) {
+    for (int x = 0; x < width; x++) {
+      uint32_t pixel = random();
+      if (!noise) {
+        uint32_t r = x * 255 / width, g = y * 255 / height;
+        uint32_t b = (pixel & 0x1F) + 64;
+        pixel = r | (g << 8) | (b << 16);
+      }
+      pixels[TWOD_TO_1D(x, (size_t)y, width)] = pixel | 0xFF000000;
+    }
+  }
+}
+
+ImageView viewOf(std::vector<PixelSorter_Pixel_t> &pixels, int width,
+                 int height) {
+  return {pixels.data(), width, height,
+          (int)(width * sizeof(PixelSorter_Pixel_t)), PIXELFORMAT_ABGR8888};
+}
+
+void setCounters(benchmark::State &state, double pixels,
+                 size_t allocationsBefore) {
+  state.counters["Mpixels"] = benchmark::Counter(
+      pixels / 1e6, benchmark::Counter::kIsIterationInvariantRate);
+  state.counters["allocs"] = benchmark::Counter(
+      allocationCount() - allocationsBefore,
+      benchmark::Counter::kAvgIterations);
+}
+
+PerfCounter::PerfCounter(Event event) {
+#ifdef __linux__
+  perf_event_attr attributes = {};
+  attributes.size = sizeof(attributes);
+  if (event == CACHE_MISSES) {
+    attributes.type = PERF_TYPE_HARDWARE;
+    attributes.config = PERF_COUNT_HW_CACHE_MISSES;
+  } else {
+    attributes.type = PERF_TYPE_HW_CACHE;
+    attributes.config = PERF_COUNT_HW_CACHE_L1D |
+                        (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                        (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+  }
+  attributes.disabled = 1;
+  attributes.exclude_kernel = 1;
+  attributes.exclude_hv = 1;
+  // This thread, on any CPU
+  fd = syscall(SYS_perf_event_open, &attributes, 0, -1, -1, 0);
+  if (fd >= 0) {
+    ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+    ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+  }
+#else
+  (void)event;
+#endif
+}
+
+PerfCounter::~PerfCounter() {
+#ifdef __linux__
+  if (fd >= 0) {
+    close(fd);
+  }
+#endif
+}
+
+long long PerfCounter::count() const {
+  long long events = 0;
+#ifdef __linux__
+  if (fd < 0 || read(fd, &events, sizeof(events)) != sizeof(events)) {
+    return 0;
+  }
+#endif
+  return events;
+}
+
+void setPerfCounter(benchmark::State &state, const char *name,
+                    const PerfCounter &counter, double pixels) {
+  if (!counter.available() || state.iterations() == 0) {
+    return;
+  }
+  state.counters[name] = counter.count() / pixels / state.iterations();
+}
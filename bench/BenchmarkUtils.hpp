@@ -0,0 +1,70 @@
+/*
+ * Helpers shared by the benchmarks: test images, the counters every
+ * benchmark reports (pixels per second, and memory allocations), and hardware
+ * cache miss counters.
+ */
+
+#ifndef BENCHMARKUTILS_HPP_
+#define BENCHMARKUTILS_HPP_
+
+#include "ImageView.hpp"
+#include "PixelSorter.hpp"
+#include <benchmark/benchmark.h>
+#include <cstddef>
+#include <vector>
+
+// Fill pixels with a width by height image of opaque pixels. Noise uses
+// every color in random order. Otherwise it is a noisy gradient, where nearby
+// pixels have similar colors like in a photo
+void makeTestImage(std::vector<PixelSorter_Pixel_t> &pixels, int width,
+                   int height, bool noise);
+
+// A view of a width by height image held in pixels, with no padding
+ImageView viewOf(std::vector<PixelSorter_Pixel_t> &pixels, int width,
+                 int height);
+
+// Number of allocations made with operator new so far
+size_t allocationCount();
+
+/*
+ * Report how fast pixels were processed (Mpixels, per second) and how many
+ * allocations each iteration made (allocs). pixels is the number processed
+ * by each iteration, and allocationsBefore is allocationCount() from just
+ * before the benchmark loop. Allocations made with malloc are not counted.
+ */
+void setCounters(benchmark::State &state, double pixels,
+                 size_t allocationsBefore);
+
+/*
+ * Counts a hardware event of the calling thread from when it is made, with the
+ * perf_event_open system call of Linux. Where hardware counters can not be
+ * used (other systems, most virtual machines, or when perf_event_paranoid
+ * forbids it) available() is false. Threads other than the calling one are not
+ * counted, so only use it for single threaded benchmarks.
+ */
+class PerfCounter {
+public:
+  enum Event {
+    CACHE_MISSES,   // Misses of the last level cache
+    L1D_READ_MISSES // Reads that missed the level 1 data cache
+  };
+
+  PerfCounter(Event event);
+  ~PerfCounter();
+  PerfCounter(const PerfCounter &) = delete;
+  PerfCounter &operator=(const PerfCounter &) = delete;
+
+  bool available() const { return fd >= 0; }
+  // Events counted so far
+  long long count() const;
+
+private:
+  int fd = -1;
+};
+
+// Report the events counter has counted per pixel as name, averaged over the
+// iterations. Nothing is reported if the counter is not available
+void setPerfCounter(benchmark::State &state, const char *name,
+                    const PerfCounter &counter, double pixels);
+
+#endif // BENCHMARKUTILS_HPP_
@@ -0,0 +1,77 @@
+/*
+ * Compare converting an image's pixels directly against looking them up in a
+ * ColorTable, for the converters that have no integer version.
+ */
+
+#include "BenchmarkUtils.hpp"
+#include "ColorConversion.hpp"
+#include "ColorTable.hpp"
+#include "ImageView.hpp"
+#include "KeyPlane.hpp"
+#include "global.hpp"
+#include <benchmark/benchmark.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Size of the image converted, in pixels per side
+#define IMAGE_SIDE 2048
+
+// Converters that can use a table, and a name for their table
+static ColorConverter *const tableConverters[] = {
+    &ColorConversion::hue, &ColorConversion::saturation,
+    &ColorConversion::saturation_HSL, &ColorConversion::lightness};
+static const char *const tableNames[] = {"hue", "saturation", "saturation_hsl",
+                                         "lightness"};
+
+// A square test image, see makeTestImage. Noise is the worst case for a table
+static std::vector<PixelSorter_Pixel_t> &testImage(bool noise) {
+  static std::vector<PixelSorter_Pixel_t> images[2];
+  std::vector<PixelSorter_Pixel_t> &pixels = images[noise];
+  if (pixels.empty()) {
+    makeTestImage(pixels, IMAGE_SIDE, IMAGE_SIDE, noise);
+  }
+  return pixels;
+}
+
+// Convert the whole image every iteration, with or without a table
+static void convertImage(benchmark::State &state, bool useTable) {
+  ColorConverter *converter = tableConverters[state.range(0)];
+  std::vector<PixelSorter_Pixel_t> &pixels = testImage(state.range(1));
+  ImageView image = viewOf(pixels, IMAGE_SIDE, IMAGE_SIDE);
+
+  const ColorTable *table = NULL;
+  if (useTable) {
+    ColorTable::setMemoryBudget(ColorTable::tableBytes() *
+                                arrayLen(tableConverters));
+    table = ColorTable::get(converter, tableNames[state.range(0)]);
+  }
+  state.SetLabel(std::string(tableNames[state.range(0)]) +
+                 (state.range(1) ? " noise" : " gradient"));
+
+  // Convert once first, so the keys are already allocated
+  KeyPlane keyPlane;
+  keyPlane.update(image, converter, NULL, table);
+  size_t allocationsBefore = allocationCount();
+  for (auto _ : state) {
+    keyPlane.invalidate();
+    benchmark::DoNotOptimize(keyPlane.update(image, converter, NULL, table));
+  }
+  setCounters(state, pixels.size(), allocationsBefore);
+}
+
+static void BM_DirectConversion(benchmark::State &state) {
+  convertImage(state, false);
+}
+
+static void BM_TableConversion(benchmark::State &state) {
+  convertImage(state, true);
+}
+
+// Arguments are the index into tableConverters, and if the image is noise
+BENCHMARK(BM_DirectConversion)
+    ->ArgsProduct({benchmark::CreateDenseRange(0, 3, 1), {0, 1}})
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_TableConversion)
+    ->ArgsProduct({benchmark::CreateDenseRange(0, 3, 1), {0, 1}})
+    ->Unit(benchmark::kMillisecond);
@@ -0,0 +1,44 @@
+/*
+ * How fast each quantizer converts an image's pixels to the keys they are
+ * sorted by, the way the GUI does it (integer or batch versions when there is
+ * one, and no lookup tables).
+ */
+
+#include "BenchmarkUtils.hpp"
+#include "ColorTable.hpp"
+#include "KeyPlane.hpp"
+#include "Quantizers.hpp"
+#include <benchmark/benchmark.h>
+#include <vector>
+
+// Size of the image converted, in pixels per side
+#define IMAGE_SIDE 2048
+
+static void BM_Keys(benchmark::State &state) {
+  const QuantizerOptionItem &quantizer = quantizer_options[state.range(0)];
+  static std::vector<PixelSorter_Pixel_t> images[2];
+  std::vector<PixelSorter_Pixel_t> &pixels = images[state.range(1)];
+  if (pixels.empty()) {
+    makeTestImage(pixels, IMAGE_SIDE, IMAGE_SIDE, state.range(1));
+  }
+  ImageView image = viewOf(pixels, IMAGE_SIDE, IMAGE_SIDE);
+  ColorTable::setMemoryBudget(0);
+  state.SetLabel(quantizer.id + (state.range(1) ? " noise" : " gradient"));
+
+  // Convert once first, so the keys are already allocated
+  KeyPlane keyPlane;
+  quantizePixels(quantizer, keyPlane, image);
+  size_t allocationsBefore = allocationCount();
+  for (auto _ : state) {
+    keyPlane.invalidate();
+    benchmark::DoNotOptimize(quantizePixels(quantizer, keyPlane, image));
+  }
+  setCounters(state, pixels.size(), allocationsBefore);
+}
+
+// Arguments are the index into quantizer_options, and if the image is noise
+BENCHMARK(BM_Keys)
+    ->ArgsProduct({benchmark::CreateDenseRange(0, quantizer_options_count - 1,
+                                               1),
+                   {0, 1}})
+    ->Unit(benchmark::kMillisecond);
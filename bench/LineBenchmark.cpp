@@ -0,0 +1,32 @@
+/*
+ * How fast the line that every line of a sort is a copy of is generated, for
+ * different image sizes and angles.
+ */
+
+#include "BenchmarkUtils.hpp"
+#include "LineCollision.hpp"
+#include "LineInterpolator.hpp"
+#include <benchmark/benchmark.h>
+
+// Arguments are the width and height of the image, and the angle in degrees
+static void BM_GenerateLine(benchmark::State &state) {
+  int side = state.range(0);
+  // Reused like SortWorkspace does, so only the first line allocates
+  LineCollision::LineRuns runs;
+  size_t allocationsBefore = allocationCount();
+  for (auto _ : state) {
+    double angle = state.range(1);
+    BresenhamsArguments bresenhamsArgs(0, 0);
+    LineCollision::generateLineRunsForRect(angle, side, side, bresenhamsArgs,
+                                           runs);
+    benchmark::DoNotOptimize(runs.starts.data());
+  }
+  size_t numPoints = runs.numPoints;
+  state.counters["runs"] = runs.numRuns();
+  // Report points generated per second as pixels
+  setCounters(state, numPoints, allocationsBefore);
+}
+
+BENCHMARK(BM_GenerateLine)
+    ->ArgsProduct({{1000, 4000, 10000}, {0, 45, 30}})
+    ->Unit(benchmark::kMicrosecond);
@@ -0,0 +1,242 @@
+/*
+ * How fast pixels are sorted: a single band (span) of a line by its length,
+ * and whole images by size, angle and how wide the range of sorted values is.
+ */
+
+#include "BenchmarkUtils.hpp"
+#include "KeyPlane.hpp"
+#include "PixelSorter.hpp"
+#include "Quantizers.hpp"
+#include "SortWorkspace.hpp"
+#include "ThreadPool.hpp"
+#include <benchmark/benchmark.h>
+#include <cmath>
+#include <memory>
+#include <random>
+#include <vector>
+
+// Argument is the number of pixels in the band
+static void BM_SortBand(benchmark::State &state) {
+  int length = state.range(0);
+  std::mt19937 random(1);
+  std::vector<PixelSorter_Pixel_t> input(length);
+  std::vector<PixelSorter_Pixel_t> output(length);
+  std::vector<PixelSorter_value_t> values(length);
+  std::vector<int> pixelIndexes(length);
+  std::vector<Count_t> count(PRECISION + 1);
+  std::vector<int> order(2 * length);
+  for (int i = 0; i < length; i++) {
+    input[i] = random();
+    values[i] = input[i] & PRECISION;
+    pixelIndexes[i] = i;
+  }
+  PixelSorter_Pixel_t *inputPixels = input.data();
+  PixelSorter_Pixel_t *outputPixels = output.data();
+
+  size_t allocationsBefore = allocationCount();
+  for (auto _ : state) {
+    PixelSorter::sortBand(inputPixels, outputPixels, values.data(),
+                          pixelIndexes.data(), count.data(), order.data(),
+                          length, length, 1, 0, length);
+    benchmark::ClobberMemory();
+  }
+  setCounters(state, length, allocationsBefore);
+}
+
+BENCHMARK(BM_SortBand)->RangeMultiplier(2)->Range(2, 16384);
+
+/*
+ * Arguments are the size of the image in megapixels, the angle in degrees,
+ * the width of the range of sorted values in percent (centered on 50%), and
+ * the number of threads (0 for one per core). The keys are computed before
+ * timing, so this only measures generating the lines and sorting them.
+ */
+static void BM_SortImage(benchmark::State &state) {
+  int side = std::round(std::sqrt(state.range(0) * 1e6));
+  double angle = state.range(1);
+  double rangeWidth = state.range(2) / 100.0;
+  int threads = state.range(3);
+
+  // Only keep the images of one size around, the largest take up 1 GB
+  static int imageSide = 0;
+  static std::vector<PixelSorter_Pixel_t> input;
+  static std::vector<PixelSorter_Pixel_t> output;
+  static KeyPlane keyPlane;
+  if (imageSide != side) {
+    makeTestImage(input, side, side, false);
+    output.assign(input.size(), 0);
+    keyPlane.invalidate();
+    imageSide = side;
+  }
+  ImageView inputView = viewOf(input, side, side);
+  ImageView outputView = viewOf(output, side, side);
+  const PixelSorter_value_t *keys =
+      quantizePixels(*findQuantizer("lightness"), keyPlane, inputView);
+
+  std::unique_ptr<ThreadPool> pool;
+  if (threads != 1) {
+    pool = std::make_unique<ThreadPool>(threads);
+  }
+  SortWorkspace workspace;
+  size_t allocationsBefore = allocationCount();
+  // Only count this thread, so only sorts without a pool are counted fully
+  PerfCounter cacheMisses(PerfCounter::CACHE_MISSES);
+  PerfCounter l1Misses(PerfCounter::L1D_READ_MISSES);
+  for (auto _ : state) {
+    PixelSorter::sortImage(inputView, outputView, angle, 0.5 - rangeWidth / 2,
+                           0.5 + rangeWidth / 2, keys, workspace, pool.get());
+  }
+  setCounters(state, input.size(), allocationsBefore);
+  if (pool == nullptr) {
+    setPerfCounter(state, "misses/px", cacheMisses, input.size());
+    setPerfCounter(state, "L1misses/px", l1Misses, input.size());
+  }
+}
+
+BENCHMARK(BM_SortImage)
+    ->ArgsProduct({{1, 4, 16, 100}, {0, 90, 60, 45, 30}, {10, 50, 100}, {1}})
+    ->ArgsProduct({{16}, {0, 90, 60, 45, 30}, {50}, {0}})
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+/*
+ * Arguments are the angle in degrees and the bits of each key (8, 12 or 16).
+ * Sorts a 4 megapixel image by hue, over half the range of values, so that
+ * the cost of wider keys can be compared with the 8 bit path.
+ */
+static void BM_SortImageKeyBits(benchmark::State &state) {
+  int side = 2000;
+  double angle = state.range(0);
+  int keyBits = state.range(1);
+
+  static std::vector<PixelSorter_Pixel_t> input;
+  static std::vector<PixelSorter_Pixel_t> output;
+  if (input.empty()) {
+    makeTestImage(input, side, side, false);
+    output.assign(input.size(), 0);
+  }
+  ImageView inputView = viewOf(input, side, side);
+  ImageView outputView = viewOf(output, side, side);
+  KeyPlane keyPlane;
+  const QuantizerOptionItem &quantizer = *findQuantizer("hue");
+  const PixelSorter_value_t *keys = NULL;
+  const PixelSorter_wideValue_t *wideKeys = NULL;
+  if (keyBits > 8) {
+    wideKeys = quantizePixelsWide(quantizer, keyPlane, inputView, keyBits);
+  } else {
+    keys = quantizePixels(quantizer, keyPlane, inputView);
+  }
+
+  SortWorkspace workspace;
+  size_t allocationsBefore = allocationCount();
+  for (auto _ : state) {
+    if (keyBits > 8) {
+      PixelSorter::sortImage(inputView, outputView, angle, 0.25, 0.75,
+                             wideKeys, keyBits, workspace);
+    } else {
+      PixelSorter::sortImage(inputView, outputView, angle, 0.25, 0.75, keys,
+                             workspace);
+    }
+  }
+  setCounters(state, input.size(), allocationsBefore);
+}
+
+BENCHMARK(BM_SortImageKeyBits)
+    ->ArgsProduct({{0, 90, 45}, {8, 12, 16}})
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+/*
+ * Arguments are the angle in degrees and the PixelFormat of the image (the 32
+ * bit PIXELFORMAT_ABGR8888, PIXELFORMAT_RGBA64 or PIXELFORMAT_RGBA128_FLOAT).
+ * Sorts a 4 megapixel image by the same 8 bit keys, so only the cost of moving
+ * bigger pixels is compared.
+ */
+static void BM_SortImagePixelFormat(benchmark::State &state) {
+  int side = 2000;
+  double angle = state.range(0);
+  PixelFormat format = (PixelFormat)state.range(1);
+  int pixelBytes = pixelFormatBytes(format);
+
+  static std::vector<PixelSorter_Pixel_t> pixels;
+  static std::vector<PixelRGBA32F> input; // Big enough for any format
+  static std::vector<PixelRGBA32F> output;
+  if (pixels.empty()) {
+    makeTestImage(pixels, side, side, false);
+    input.resize(pixels.size());
+    output.resize(pixels.size());
+  }
+  // Widen the test image into format
+  ImageView inputView = {input.data(), side, side, side * pixelBytes, format};
+  ImageView outputView = {output.data(), side, side, side * pixelBytes,
+                          format};
+  for (size_t i = 0; i < pixels.size(); i++) {
+    uint8_t r, g, b;
+    getRGB(pixels[i], pixelFormatShifts(PIXELFORMAT_ABGR8888), r, g, b);
+    if (format == PIXELFORMAT_RGBA64) {
+      inputView.pixelsOf<PixelRGBA16>()[i] = {(uint16_t)(r * 257),
+                                              (uint16_t)(g * 257),
+                                              (uint16_t)(b * 257), 65535};
+    } else if (format == PIXELFORMAT_RGBA128_FLOAT) {
+      inputView.pixelsOf<PixelRGBA32F>()[i] = {r / 255.0f, g / 255.0f,
+                                               b / 255.0f, 1.0f};
+    } else {
+      inputView.pixelsOf<PixelSorter_Pixel_t>()[i] = pixels[i];
+    }
+  }
+  KeyPlane keyPlane;
+  const PixelSorter_value_t *keys =
+      quantizePixels(*findQuantizer("lightness"), keyPlane, inputView);
+
+  SortWorkspace workspace;
+  size_t allocationsBefore = allocationCount();
+  for (auto _ : state) {
+    PixelSorter::sortImage(inputView, outputView, angle, 0.25, 0.75, keys,
+                           workspace);
+  }
+  setCounters(state, pixels.size(), allocationsBefore);
+}
+
+BENCHMARK(BM_SortImagePixelFormat)
+    ->ArgsProduct({{0, 90, 45},
+                   {PIXELFORMAT_ABGR8888, PIXELFORMAT_RGBA64,
+                    PIXELFORMAT_RGBA128_FLOAT}})
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+/*
+ * Arguments are the angle in degrees and whether to sort in place (0 or 1).
+ * Sorts a 4 megapixel image into a second image, or over itself. The keys are
+ * of the unsorted image both times, so every run does the same work.
+ */
+static void BM_SortImageInPlace(benchmark::State &state) {
+  int side = 2000;
+  double angle = state.range(0);
+  bool inPlace = state.range(1);
+
+  static std::vector<PixelSorter_Pixel_t> pixels;
+  if (pixels.empty()) {
+    makeTestImage(pixels, side, side, false);
+  }
+  // Copies, so that sorting in place leaves the test image as it was
+  std::vector<PixelSorter_Pixel_t> input = pixels;
+  std::vector<PixelSorter_Pixel_t> output(inPlace ? 0 : pixels.size());
+  ImageView inputView = viewOf(input, side, side);
+  ImageView outputView = inPlace ? inputView : viewOf(output, side, side);
+  KeyPlane keyPlane;
+  const PixelSorter_value_t *keys =
+      quantizePixels(*findQuantizer("lightness"), keyPlane, inputView);
+
+  SortWorkspace workspace;
+  size_t allocationsBefore = allocationCount();
+  for (auto _ : state) {
+    PixelSorter::sortImage(inputView, outputView, angle, 0.25, 0.75, keys,
+                           workspace);
+  }
+  setCounters(state, input.size(), allocationsBefore);
+}
+
+BENCHMARK(BM_SortImageInPlace)
+    ->ArgsProduct({{0, 90, 45, 30}, {0, 1}})
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
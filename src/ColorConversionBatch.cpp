@@ -0,0 +1,202 @@
+#include "ColorConversionBatch.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define COLORCONVERSIONBATCH_X86
+#include <immintrin.h>
+#endif
+
+/*
+ * Every batch converter is built from an operation, which has the same
+ * conversion written three ways: one pixel at a time with its integer
+ * converter (used for the pixels left over at the end of a row), and on 4 or 8
+ * pixels at a time with SSE4.1 or AVX2. All are exact, and only use integers.
+ *
+ * Pixels are ABGR8888, so each 32 bit lane holds a pixel as 0xAABBGGRR.
+ * The vector versions must leave the value in the low byte of each lane, with
+ * the rest of the lane zeroed.
+ */
+
+#define TARGET_SSE41 __attribute__((target("sse4.1")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+
+// Convert a pixel with an IntegerColorConverter
+#define CONVERT_PIXEL(_function_, _p_)                                         \
+  ColorConversion::Integer::_function_((_p_) & 0xFF, ((_p_) >> 8) & 0xFF,      \
+                                       ((_p_) >> 16) & 0xFF)
+
+// (x * 21846) >> 16 is x / 3 for all x up to 766, see Integer::average
+#define DIVIDE_BY_3_MULTIPLIER 21846
+
+#ifdef COLORCONVERSIONBATCH_X86
+#define DEFINE_VECTOR_OPS(_body_sse_, _body_avx_)                              \
+  TARGET_SSE41 static inline __m128i sse(__m128i p) { _body_sse_ }             \
+  TARGET_AVX2 static inline __m256i avx(__m256i p) { _body_avx_ }
+#else
+#define DEFINE_VECTOR_OPS(_body_sse_, _body_avx_)
+#endif
+
+struct RedOp {
+  static inline uint8_t scalar(uint32_t p) { return CONVERT_PIXEL(red, p); }
+  DEFINE_VECTOR_OPS(return _mm_and_si128(p, _mm_set1_epi32(0xFF));
+                    , return _mm256_and_si256(p, _mm256_set1_epi32(0xFF));)
+};
+
+struct GreenOp {
+  static inline uint8_t scalar(uint32_t p) { return CONVERT_PIXEL(green, p); }
+  DEFINE_VECTOR_OPS(
+      return _mm_and_si128(_mm_srli_epi32(p, 8), _mm_set1_epi32(0xFF));
+      , return _mm256_and_si256(_mm256_srli_epi32(p, 8),
+                                _mm256_set1_epi32(0xFF));)
+};
+
+struct BlueOp {
+  static inline uint8_t scalar(uint32_t p) { return CONVERT_PIXEL(blue, p); }
+  DEFINE_VECTOR_OPS(
+      return _mm_and_si128(_mm_srli_epi32(p, 16), _mm_set1_epi32(0xFF));
+      , return _mm256_and_si256(_mm256_srli_epi32(p, 16),
+                                _mm256_set1_epi32(0xFF));)
+};
+
+// Byte wise max of each channel lines up r, g and b in the low byte
+struct MaximumOp {
+  static inline uint8_t scalar(uint32_t p) {
+    return CONVERT_PIXEL(maximum, p);
+  }
+  DEFINE_VECTOR_OPS(
+      __m128i m = _mm_max_epu8(p, _mm_srli_epi32(p, 8));
+      m = _mm_max_epu8(m, _mm_srli_epi32(p, 16));
+      return _mm_and_si128(m, _mm_set1_epi32(0xFF));
+      , __m256i m = _mm256_max_epu8(p, _mm256_srli_epi32(p, 8));
+      m = _mm256_max_epu8(m, _mm256_srli_epi32(p, 16));
+      return _mm256_and_si256(m, _mm256_set1_epi32(0xFF));)
+};
+
+struct MinimumOp {
+  static inline uint8_t scalar(uint32_t p) {
+    return CONVERT_PIXEL(minimum, p);
+  }
+  DEFINE_VECTOR_OPS(
+      __m128i m = _mm_min_epu8(p, _mm_srli_epi32(p, 8));
+      m = _mm_min_epu8(m, _mm_srli_epi32(p, 16));
+      return _mm_and_si128(m, _mm_set1_epi32(0xFF));
+      , __m256i m = _mm256_min_epu8(p, _mm256_srli_epi32(p, 8));
+      m = _mm256_min_epu8(m, _mm256_srli_epi32(p, 16));
+      return _mm256_and_si256(m, _mm256_set1_epi32(0xFF));)
+};
+
+struct ChromaOp {
+  static inline uint8_t scalar(uint32_t p) { return CONVERT_PIXEL(chroma, p); }
+  DEFINE_VECTOR_OPS(
+      return _mm_sub_epi32(MaximumOp::sse(p), MinimumOp::sse(p));
+      , return _mm256_sub_epi32(MaximumOp::avx(p), MinimumOp::avx(p));)
+};
+
+struct AverageOp {
+  static inline uint8_t scalar(uint32_t p) {
+    return CONVERT_PIXEL(average, p);
+  }
+  DEFINE_VECTOR_OPS(
+      __m128i sum = _mm_add_epi32(RedOp::sse(p), GreenOp::sse(p));
+      sum = _mm_add_epi32(sum, BlueOp::sse(p));
+      sum = _mm_add_epi32(sum, _mm_set1_epi32(1));
+      sum = _mm_mullo_epi32(sum, _mm_set1_epi32(DIVIDE_BY_3_MULTIPLIER));
+      return _mm_srli_epi32(sum, 16);
+      , __m256i sum = _mm256_add_epi32(RedOp::avx(p), GreenOp::avx(p));
+      sum = _mm256_add_epi32(sum, BlueOp::avx(p));
+      sum = _mm256_add_epi32(sum, _mm256_set1_epi32(1));
+      sum = _mm256_mullo_epi32(sum,
+                               _mm256_set1_epi32(DIVIDE_BY_3_MULTIPLIER));
+      return _mm256_srli_epi32(sum, 16);)
+};
+
+// Convert the pixels one at a time
+template <class Op>
+void convertScalar(const uint32_t *pixels, uint8_t *values, int count) {
+  for (int i = 0; i < count; i++) {
+    values[i] = Op::scalar(pixels[i]);
+  }
+}
+
+#ifdef COLORCONVERSIONBATCH_X86
+// Convert 16 pixels at a time, 4 per vector
+template <class Op>
+TARGET_SSE41 void convertSSE41(const uint32_t *pixels, uint8_t *values,
+                               int count) {
+  int i = 0;
+  for (; i + 16 <= count; i += 16) {
+    const __m128i *in = (const __m128i *)(pixels + i);
+    __m128i a = Op::sse(_mm_loadu_si128(in + 0));
+    __m128i b = Op::sse(_mm_loadu_si128(in + 1));
+    __m128i c = Op::sse(_mm_loadu_si128(in + 2));
+    __m128i d = Op::sse(_mm_loadu_si128(in + 3));
+    // Every lane is below 256, so packing never saturates
+    __m128i packed =
+        _mm_packus_epi16(_mm_packus_epi32(a, b), _mm_packus_epi32(c, d));
+    _mm_storeu_si128((__m128i *)(values + i), packed);
+  }
+  convertScalar<Op>(pixels + i, values + i, count - i);
+}
+
+// Convert 32 pixels at a time, 8 per vector
+template <class Op>
+TARGET_AVX2 void convertAVX2(const uint32_t *pixels, uint8_t *values,
+                             int count) {
+  // Packing works within each 128 bit half, this puts the groups of 4 pixels
+  // back in order
+  const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+  int i = 0;
+  for (; i + 32 <= count; i += 32) {
+    const __m256i *in = (const __m256i *)(pixels + i);
+    __m256i a = Op::avx(_mm256_loadu_si256(in + 0));
+    __m256i b = Op::avx(_mm256_loadu_si256(in + 1));
+    __m256i c = Op::avx(_mm256_loadu_si256(in + 2));
+    __m256i d = Op::avx(_mm256_loadu_si256(in + 3));
+    __m256i packed = _mm256_packus_epi16(_mm256_packus_epi32(a, b),
+                                         _mm256_packus_epi32(c, d));
+    packed = _mm256_permutevar8x32_epi32(packed, order);
+    _mm256_storeu_si256((__m256i *)(values + i), packed);
+  }
+  convertScalar<Op>(pixels + i, values + i, count - i);
+}
+
+// The batch converters of an IntegerColorConverter, for each instruction set
+struct BatchConverterSet {
+  IntegerColorConverter *converter;
+  BatchConverter *avx2;
+  BatchConverter *sse41;
+};
+
+#define BATCH_CONVERTER_SET(_converter_, _op_)                                 \
+  {&_converter_, &convertAVX2<_op_>, &convertSSE41<_op_>}
+
+static const BatchConverterSet batchConverters[] = {
+    BATCH_CONVERTER_SET(ColorConversion::Integer::red, RedOp),
+    BATCH_CONVERTER_SET(ColorConversion::Integer::green, GreenOp),
+    BATCH_CONVERTER_SET(ColorConversion::Integer::blue, BlueOp),
+    BATCH_CONVERTER_SET(ColorConversion::Integer::maximum, MaximumOp),
+    BATCH_CONVERTER_SET(ColorConversion::Integer::minimum, MinimumOp),
+    BATCH_CONVERTER_SET(ColorConversion::Integer::chroma, ChromaOp),
+    BATCH_CONVERTER_SET(ColorConversion::Integer::average, AverageOp),
+};
+#endif
+
+BatchConverter *
+ColorConversion::getBatchConverter(IntegerColorConverter *converter) {
+#ifdef COLORCONVERSIONBATCH_X86
+  static const bool hasAVX2 = __builtin_cpu_supports("avx2");
+  static const bool hasSSE41 = __builtin_cpu_supports("sse4.1");
+
+  for (const BatchConverterSet &set : batchConverters) {
+    if (set.converter != converter) {
+      continue;
+    }
+    if (hasAVX2) {
+      return set.avx2;
+    }
+    if (hasSSE41) {
+      return set.sse41;
+    }
+  }
+#endif
+  return NULL;
+}
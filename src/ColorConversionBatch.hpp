@@ -0,0 +1,29 @@
+/*
+ * Batch versions of the integer ColorConversion functions, which convert whole
+ * rows of pixels at a time with SIMD instructions.
+ *
+ * A batch converter gives exactly the same value as converting each pixel with
+ * the IntegerColorConverter it is made from.
+ */
+
+#ifndef COLORCONVERSIONBATCH_HPP_
+#define COLORCONVERSIONBATCH_HPP_
+
+#include "ColorConversionInteger.hpp"
+#include <cstdint>
+
+// Convert count pixels in the PIXELFORMAT_ABGR8888 format (red in the lowest
+// byte) to values in the range 0 to 255
+typedef void BatchConverter(const uint32_t *pixels, uint8_t *values,
+                            int count);
+
+namespace ColorConversion {
+/*
+ * Get the fastest batch version of converter that this CPU supports (AVX2,
+ * then SSE4.1). Returns NULL if there is no batch version of converter, or
+ * the CPU supports neither, in which case each pixel must be converted alone.
+ */
+BatchConverter *getBatchConverter(IntegerColorConverter *converter);
+} // namespace ColorConversion
+
+#endif // COLORCONVERSIONBATCH_HPP_
@@ -0,0 +1,38 @@
+#include "ColorConversionInteger.hpp"
+#include <algorithm>
+
+// Just red
+uint8_t ColorConversion::Integer::red(uint8_t r, uint8_t g, uint8_t b) {
+  return r;
+}
+
+// Just green
+uint8_t ColorConversion::Integer::green(uint8_t r, uint8_t g, uint8_t b) {
+  return g;
+}
+
+// Just blue
+uint8_t ColorConversion::Integer::blue(uint8_t r, uint8_t g, uint8_t b) {
+  return b;
+}
+
+// The average of r, g, b, rounded. The sum divided by 3 is never a whole
+// number plus a half, so rounding it is the same as (sum + 1) / 3
+uint8_t ColorConversion::Integer::average(uint8_t r, uint8_t g, uint8_t b) {
+  return (r + g + b + 1) / 3;
+}
+
+// Return the minimum of (R,G,B)
+uint8_t ColorConversion::Integer::minimum(uint8_t r, uint8_t g, uint8_t b) {
+  return std::min(r, std::min(g, b));
+}
+
+// Return the maximum of (R,G,B)
+uint8_t ColorConversion::Integer::maximum(uint8_t r, uint8_t g, uint8_t b) {
+  return std::max(r, std::max(g, b));
+}
+
+// The range aka chroma
+uint8_t ColorConversion::Integer::chroma(uint8_t r, uint8_t g, uint8_t b) {
+  return maximum(r, g, b) - minimum(r, g, b);
+}
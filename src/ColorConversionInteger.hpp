@@ -0,0 +1,45 @@
+/*
+ * Integer versions of the ColorConversion functions that can be computed from
+ * 8 bit channels without any floating point.
+ *
+ * Each function takes r, g, b from 0 to 255 and returns exactly
+ * round(255 * converter(r / 255, g / 255, b / 255)) for the ColorConverter of
+ * the same name, so they can be used in place of it when sorting.
+ */
+
+#ifndef COLORCONVERSIONINTEGER_HPP_
+#define COLORCONVERSIONINTEGER_HPP_
+
+#include <cstdint>
+
+#define INTEGERCOLORCONVERTER_ARGS uint8_t r, uint8_t g, uint8_t b
+
+typedef uint8_t IntegerColorConverter(INTEGERCOLORCONVERTER_ARGS);
+
+namespace ColorConversion {
+namespace Integer {
+// Just red
+IntegerColorConverter red;
+
+// Just green
+IntegerColorConverter green;
+
+// Just blue
+IntegerColorConverter blue;
+
+// The average of r,g,b
+IntegerColorConverter average;
+
+// Return the minimum of (R,G,B)
+IntegerColorConverter minimum;
+
+// Return the maximum of (R,G,B). Also Value (HSV)
+IntegerColorConverter maximum;
+
+// The range aka chroma
+IntegerColorConverter chroma;
+
+} // namespace Integer
+} // namespace ColorConversion
+
+#endif // COLORCONVERSIONINTEGER_HPP_
@@ -0,0 +1,162 @@
+#include "ColorTable.hpp"
+#include "KeyPlane.hpp"
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <mutex>
+
+// Identifies a table file, and which version of the file layout it uses.
+// Bump the version whenever a converter changes, so old tables are rebuilt
+#define COLORTABLE_FILE_MAGIC "PSCT"
+#define COLORTABLE_FILE_VERSION 1
+
+// Header at the start of a table file
+struct ColorTableFileHeader {
+  char magic[4];
+  uint32_t version;
+  uint32_t valueBytes; // sizeof(PixelSorter_value_t)
+  uint32_t precision;  // PRECISION
+  uint32_t size;       // COLORTABLE_SIZE
+};
+
+/* Every table built so far, and the budget they must fit in */
+static std::mutex tablesMutex;
+static std::map<ColorConverter *, std::unique_ptr<ColorTable>> tables;
+static size_t memoryBudget = 0; // Tables are disabled until given a budget
+
+// Fill in the header that describes tables built by this program
+static ColorTableFileHeader expectedHeader() {
+  ColorTableFileHeader header;
+  memcpy(header.magic, COLORTABLE_FILE_MAGIC, sizeof(header.magic));
+  header.version = COLORTABLE_FILE_VERSION;
+  header.valueBytes = sizeof(PixelSorter_value_t);
+  header.precision = PRECISION;
+  header.size = COLORTABLE_SIZE;
+  return header;
+}
+
+const ColorTable *ColorTable::get(ColorConverter *converter,
+                                  const std::string &name, ThreadPool *pool) {
+  std::lock_guard<std::mutex> lock(tablesMutex);
+  if (memoryBudget == 0) {
+    return NULL;
+  }
+  auto found = tables.find(converter);
+  if (found != tables.end()) {
+    return found->second.get();
+  }
+  if ((tables.size() + 1) * tableBytes() > memoryBudget) {
+    return NULL; // No room for another table
+  }
+
+  std::unique_ptr<ColorTable> table(new ColorTable());
+  std::string directory = cacheDirectory();
+  std::string path = directory.empty() ? "" : directory + "/" + name + ".lut";
+  if (path.empty() || !table->load(path)) {
+    table->build(converter, pool);
+    if (!path.empty() && !table->save(path)) {
+      fprintf(stderr, "ColorTable: Could not cache table to %s\n",
+              path.c_str());
+    }
+  }
+  const ColorTable *result = table.get();
+  tables[converter] = std::move(table);
+  return result;
+}
+
+void ColorTable::setMemoryBudget(size_t bytes) {
+  std::lock_guard<std::mutex> lock(tablesMutex);
+  memoryBudget = bytes;
+}
+
+size_t ColorTable::getMemoryBudget() {
+  std::lock_guard<std::mutex> lock(tablesMutex);
+  return memoryBudget;
+}
+
+std::string ColorTable::cacheDirectory() {
+  const char *cacheHome = getenv("XDG_CACHE_HOME");
+  if (cacheHome != NULL && cacheHome[0] != '\0') {
+    return std::string(cacheHome) + "/pixel_sorter";
+  }
+  const char *home = getenv("HOME");
+  if (home != NULL && home[0] != '\0') {
+    return std::string(home) + "/.cache/pixel_sorter";
+  }
+  return "";
+}
+
+// Convert every color, one blue level per block
+void ColorTable::build(ColorConverter *converter, ThreadPool *pool) {
+  values.resize(COLORTABLE_SIZE);
+  auto buildBlues = [&](int firstBlue, int endBlue, int worker) {
+    for (int b = firstBlue; b < endBlue; b++) {
+      for (int g = 0; g <= UINT8_MAX; g++) {
+        for (int r = 0; r <= UINT8_MAX; r++) {
+          values[r | (g << 8) | (b << 16)] =
+              KeyPlane::convertColor(converter, r, g, b);
+        }
+      }
+    }
+  };
+  if (pool == NULL) {
+    buildBlues(0, UINT8_MAX + 1, 0);
+  } else {
+    pool->parallelFor(0, UINT8_MAX + 1, 1, buildBlues);
+  }
+}
+
+// Read the table from path, returns false if it is missing or out of date
+bool ColorTable::load(const std::string &path) {
+  FILE *file = fopen(path.c_str(), "rb");
+  if (file == NULL) {
+    return false;
+  }
+  ColorTableFileHeader header;
+  ColorTableFileHeader expected = expectedHeader();
+  bool loaded = fread(&header, sizeof(header), 1, file) == 1 &&
+                memcmp(&header, &expected, sizeof(header)) == 0;
+  if (loaded) {
+    values.resize(COLORTABLE_SIZE);
+    loaded = fread(values.data(), sizeof(PixelSorter_value_t), values.size(),
+                   file) == values.size();
+  }
+  fclose(file);
+  if (!loaded) {
+    values.clear();
+  }
+  return loaded;
+}
+
+// Write the table to path. Written to a temporary file first so that other
+// instances never read half of a table
+bool ColorTable::save(const std::string &path) const {
+  std::error_code error;
+  std::filesystem::create_directories(
+      std::filesystem::path(path).parent_path(), error);
+  if (error) {
+    return false;
+  }
+
+  std::string temporaryPath = path + ".tmp";
+  FILE *file = fopen(temporaryPath.c_str(), "wb");
+  if (file == NULL) {
+    return false;
+  }
+  ColorTableFileHeader header = expectedHeader();
+  bool saved = fwrite(&header, sizeof(header), 1, file) == 1 &&
+               fwrite(values.data(), sizeof(PixelSorter_value_t),
+                      values.size(), file) == values.size();
+  saved = (fclose(file) == 0) && saved;
+  if (saved) {
+    saved = rename(temporaryPath.c_str(), path.c_str()) == 0;
+  }
+  if (!saved) {
+    remove(temporaryPath.c_str());
+  }
+  return saved;
+}
@@ -0,0 +1,69 @@
+/*
+ * Lookup tables holding the value of every 24 bit color for a converter.
+ *
+ * Converters like hue and saturation branch and divide for every pixel. A
+ * table of all 2^24 colors (16 MiB at 8 bits per value) turns each pixel into
+ * a single load. Tables are built the first time they are needed, saved to
+ * the cache directory so the next run only has to read them, and are only
+ * kept while they fit within a memory budget.
+ */
+
+#ifndef COLORTABLE_HPP_
+#define COLORTABLE_HPP_
+
+#include "ColorConversion.hpp"
+#include "PixelSorter.hpp"
+#include "ThreadPool.hpp"
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Number of colors in a table, one per 24 bit color
+#define COLORTABLE_SIZE (1 << 24)
+// Mask an ABGR8888 pixel to its index in a table
+#define COLORTABLE_INDEX_MASK 0x00FFFFFF
+
+class ColorTable {
+public:
+  // The value of the color r, g, b
+  PixelSorter_value_t lookup(uint8_t r, uint8_t g, uint8_t b) const {
+    return values[r | (g << 8) | (b << 16)];
+  }
+
+  // All values, indexed by r | g << 8 | b << 16
+  const PixelSorter_value_t *data() const { return values.data(); }
+
+  /*
+   * Get the table for converter, where name is a unique name for converter
+   * used to name its cache file. The table is loaded from the cache, or
+   * built across the workers of pool (if not NULL) and then cached.
+   * Returns NULL if the table would not fit in the memory budget.
+   * Tables live until the program exits.
+   */
+  static const ColorTable *get(ColorConverter *converter,
+                               const std::string &name,
+                               ThreadPool *pool = NULL);
+
+  // Set how many bytes all tables may take up together. 0 disables tables.
+  // Tables that are already built are kept.
+  static void setMemoryBudget(size_t bytes);
+  static size_t getMemoryBudget();
+
+  // Size of a single table, in bytes
+  static constexpr size_t tableBytes() {
+    return COLORTABLE_SIZE * sizeof(PixelSorter_value_t);
+  }
+
+  // Directory tables are cached in. Empty if there is no home directory
+  static std::string cacheDirectory();
+
+private:
+  ColorTable() {}
+  void build(ColorConverter *converter, ThreadPool *pool);
+  bool load(const std::string &path);
+  bool save(const std::string &path) const;
+
+  std::vector<PixelSorter_value_t> values;
+};
+
+#endif // COLORTABLE_HPP_
@@ -0,0 +1,498 @@
+#include "FastImageFile.hpp"
+#include <algorithm>
+#include <cctype>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+
+// Identifies a raw image file, and which version of the file layout it uses.
+// Bump the version whenever the header or PixelFormat changes
+#define RAW_IMAGE_MAGIC "PSRI"
+#define RAW_IMAGE_VERSION 1
+
+// Parts of a QOI file, see https://qoiformat.org/qoi-specification.pdf
+#define QOI_MAGIC "qoif"
+#define QOI_HEADER_BYTES 14
+#define QOI_OP_INDEX 0x00
+#define QOI_OP_DIFF 0x40
+#define QOI_OP_LUMA 0x80
+#define QOI_OP_RUN 0xc0
+#define QOI_OP_RGB 0xfe
+#define QOI_OP_RGBA 0xff
+#define QOI_OP_MASK 0xc0
+#define QOI_MAX_RUN 62
+#define QOI_INDEX_SIZE 64
+// Most bytes a pixel takes, as a QOI_OP_RGBA
+#define QOI_MAX_PIXEL_BYTES 5
+static const uint8_t QOI_END[8] = {0, 0, 0, 0, 0, 0, 0, 1};
+
+// Longest line read from the header of a PAM file
+#define PAM_LINE_LENGTH 256
+
+// Header at the start of a raw image file, in this machine's byte order
+struct RawImageHeader {
+  char magic[4];
+  uint32_t version;
+  uint32_t width;
+  uint32_t height;
+  uint32_t format; // A PixelFormat
+};
+
+FastImageType fastImageType(const std::string &path) {
+  std::string extension = std::filesystem::path(path).extension().string();
+  std::transform(extension.begin(), extension.end(), extension.begin(),
+                 ::tolower);
+  if (extension == ".qoi") {
+    return FAST_IMAGE_QOI;
+  }
+  if (extension == ".pam") {
+    return FAST_IMAGE_PAM;
+  }
+  if (extension == ".rgba") {
+    return FAST_IMAGE_RAW;
+  }
+  return FAST_IMAGE_NONE;
+}
+
+// Private helper to store value at bytes, most significant byte first
+static void putBigEndian(uint8_t *bytes, uint32_t value) {
+  bytes[0] = value >> 24;
+  bytes[1] = value >> 16;
+  bytes[2] = value >> 8;
+  bytes[3] = value;
+}
+
+// Private helper to read a value stored most significant byte first
+static uint32_t getBigEndian(const uint8_t *bytes) {
+  return (uint32_t)bytes[0] << 24 | bytes[1] << 16 | bytes[2] << 8 | bytes[3];
+}
+
+// Private helper to make a PIXELFORMAT_ABGR8888 pixel
+static inline uint32_t abgrPixel(uint8_t r, uint8_t g, uint8_t b, uint8_t a) {
+  return r | g << 8 | b << 16 | (uint32_t)a << 24;
+}
+
+// Private helper to cut a floating point channel to 8 bits
+static inline uint8_t narrowChannel(float channel) {
+  // Written so that NaN becomes 0
+  return channel > 0 ? (channel < 1 ? channel * 255 + 0.5f : 255) : 0;
+}
+
+// Private helper to get row y of image as PIXELFORMAT_ABGR8888 pixels, with
+// deeper channels cut to 8 bits
+static void rowToABGR(const ImageView &image, int y, uint32_t *abgr) {
+  const uint8_t *row = (const uint8_t *)image.pixels + (size_t)y * image.stride;
+  if (image.format == PIXELFORMAT_ABGR8888) {
+    memcpy(abgr, row, (size_t)image.width * sizeof(uint32_t));
+  } else if (image.format == PIXELFORMAT_RGBA128_FLOAT) {
+    const PixelRGBA32F *pixels = (const PixelRGBA32F *)row;
+    for (int x = 0; x < image.width; x++) {
+      abgr[x] =
+          abgrPixel(narrowChannel(pixels[x].r), narrowChannel(pixels[x].g),
+                    narrowChannel(pixels[x].b), narrowChannel(pixels[x].a));
+    }
+  } else if (image.format == PIXELFORMAT_RGBA64) {
+    const PixelRGBA16 *pixels = (const PixelRGBA16 *)row;
+    for (int x = 0; x < image.width; x++) {
+      abgr[x] = abgrPixel(pixels[x].r >> 8, pixels[x].g >> 8,
+                          pixels[x].b >> 8, pixels[x].a >> 8);
+    }
+  } else {
+    PixelFormatShifts shifts = pixelFormatShifts(image.format);
+    const uint32_t *pixels = (const uint32_t *)row;
+    for (int x = 0; x < image.width; x++) {
+      abgr[x] = abgrPixel(pixels[x] >> shifts.r, pixels[x] >> shifts.g,
+                          pixels[x] >> shifts.b, pixels[x] >> shifts.a);
+    }
+  }
+}
+
+// Private helper to allocate pixels for a width by height image of format,
+// and point view at them. Returns false if the image is too big to hold
+static bool allocateImage(int64_t width, int64_t height, PixelFormat format,
+                          std::vector<uint8_t> &pixels, ImageView &view) {
+  int pixelBytes = pixelFormatBytes(format);
+  if (width < 1 || height < 1 || width > INT_MAX / pixelBytes ||
+      height > INT_MAX) {
+    return false;
+  }
+  pixels.resize((size_t)width * height * pixelBytes);
+  view.pixels = pixels.data();
+  view.width = width;
+  view.height = height;
+  view.stride = width * pixelBytes;
+  view.format = format;
+  return true;
+}
+
+// Private helper to write image to file as QOI. Returns false on failure
+static bool saveQoi(FILE *file, const ImageView &image) {
+  uint8_t header[QOI_HEADER_BYTES];
+  memcpy(header, QOI_MAGIC, 4);
+  putBigEndian(header + 4, image.width);
+  putBigEndian(header + 8, image.height);
+  header[12] = 4; // RGBA
+  header[13] = 0; // sRGB
+  if (fwrite(header, 1, sizeof(header), file) != sizeof(header)) {
+    return false;
+  }
+
+  std::vector<uint32_t> row(image.width);
+  std::vector<uint8_t> encoded((size_t)image.width * QOI_MAX_PIXEL_BYTES + 1);
+  uint32_t index[QOI_INDEX_SIZE] = {};
+  uint32_t previous = abgrPixel(0, 0, 0, 255);
+  int run = 0;
+  for (int y = 0; y < image.height; y++) {
+    rowToABGR(image, y, row.data());
+    uint8_t *out = encoded.data();
+    for (int x = 0; x < image.width; x++) {
+      uint32_t pixel = row[x];
+      if (pixel == previous) {
+        if (++run == QOI_MAX_RUN) {
+          *out++ = QOI_OP_RUN | (run - 1);
+          run = 0;
+        }
+        continue;
+      }
+      if (run > 0) {
+        *out++ = QOI_OP_RUN | (run - 1);
+        run = 0;
+      }
+      uint8_t r = pixel, g = pixel >> 8, b = pixel >> 16, a = pixel >> 24;
+      int hash = (r * 3 + g * 5 + b * 7 + a * 11) % QOI_INDEX_SIZE;
+      if (index[hash] == pixel) {
+        *out++ = QOI_OP_INDEX | hash;
+      } else if (a != previous >> 24) {
+        index[hash] = pixel;
+        *out++ = QOI_OP_RGBA;
+        *out++ = r;
+        *out++ = g;
+        *out++ = b;
+        *out++ = a;
+      } else {
+        index[hash] = pixel;
+        // Differences from the previous pixel, wrapping around
+        int dr = (int8_t)(r - (uint8_t)previous);
+        int dg = (int8_t)(g - (uint8_t)(previous >> 8));
+        int db = (int8_t)(b - (uint8_t)(previous >> 16));
+        int drg = dr - dg;
+        int dbg = db - dg;
+        if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 &&
+            db <= 1) {
+          *out++ = QOI_OP_DIFF | (dr + 2) << 4 | (dg + 2) << 2 | (db + 2);
+        } else if (dg >= -32 && dg <= 31 && drg >= -8 && drg <= 7 &&
+                   dbg >= -8 && dbg <= 7) {
+          *out++ = QOI_OP_LUMA | (dg + 32);
+          *out++ = (drg + 8) << 4 | (dbg + 8);
+        } else {
+          *out++ = QOI_OP_RGB;
+          *out++ = r;
+          *out++ = g;
+          *out++ = b;
+        }
+      }
+      previous = pixel;
+    }
+    // A run ends with the image
+    if (y == image.height - 1 && run > 0) {
+      *out++ = QOI_OP_RUN | (run - 1);
+    }
+    size_t size = out - encoded.data();
+    if (fwrite(encoded.data(), 1, size, file) != size) {
+      return false;
+    }
+  }
+  return fwrite(QOI_END, 1, sizeof(QOI_END), file) == sizeof(QOI_END);
+}
+
+// Private helper to read a whole QOI file into pixels. Returns false on
+// failure
+static bool loadQoi(FILE *file, std::vector<uint8_t> &pixels,
+                    ImageView &view) {
+  std::vector<uint8_t> data;
+  if (fseek(file, 0, SEEK_END) != 0) {
+    return false;
+  }
+  long size = ftell(file);
+  if (size < QOI_HEADER_BYTES + (long)sizeof(QOI_END) ||
+      fseek(file, 0, SEEK_SET) != 0) {
+    return false;
+  }
+  data.resize(size);
+  if (fread(data.data(), 1, size, file) != (size_t)size ||
+      memcmp(data.data(), QOI_MAGIC, 4) != 0 ||
+      !allocateImage(getBigEndian(&data[4]), getBigEndian(&data[8]),
+                     PIXELFORMAT_ABGR8888, pixels, view)) {
+    return false;
+  }
+
+  uint32_t *out = (uint32_t *)pixels.data();
+  size_t count = (size_t)view.width * view.height;
+  // Ops are at most 5 bytes, so none can read past the end marker
+  size_t position = QOI_HEADER_BYTES;
+  size_t opsEnd = size - sizeof(QOI_END);
+  uint32_t index[QOI_INDEX_SIZE] = {};
+  uint8_t r = 0, g = 0, b = 0, a = 255;
+  int run = 0;
+  for (size_t i = 0; i < count; i++) {
+    if (run > 0) {
+      run--;
+    } else if (position < opsEnd) {
+      uint8_t op = data[position++];
+      if (op == QOI_OP_RGB) {
+        r = data[position++];
+        g = data[position++];
+        b = data[position++];
+      } else if (op == QOI_OP_RGBA) {
+        r = data[position++];
+        g = data[position++];
+        b = data[position++];
+        a = data[position++];
+      } else if ((op & QOI_OP_MASK) == QOI_OP_INDEX) {
+        uint32_t pixel = index[op];
+        r = pixel;
+        g = pixel >> 8;
+        b = pixel >> 16;
+        a = pixel >> 24;
+      } else if ((op & QOI_OP_MASK) == QOI_OP_DIFF) {
+        r += ((op >> 4) & 3) - 2;
+        g += ((op >> 2) & 3) - 2;
+        b += (op & 3) - 2;
+      } else if ((op & QOI_OP_MASK) == QOI_OP_LUMA) {
+        uint8_t next = data[position++];
+        int dg = (op & 0x3f) - 32;
+        r += dg - 8 + (next >> 4);
+        g += dg;
+        b += dg - 8 + (next & 0x0f);
+      } else {
+        run = op & 0x3f;
+      }
+      index[(r * 3 + g * 5 + b * 7 + a * 11) % QOI_INDEX_SIZE] =
+          abgrPixel(r, g, b, a);
+    } else {
+      return false; // The file ends too soon
+    }
+    out[i] = abgrPixel(r, g, b, a);
+  }
+  return true;
+}
+
+// Private helper to write image to file as PAM. Returns false on failure
+static bool savePam(FILE *file, const ImageView &image) {
+  bool deep = image.format == PIXELFORMAT_RGBA64;
+  if (fprintf(file,
+              "P7\nWIDTH %d\nHEIGHT %d\nDEPTH 4\nMAXVAL %d\n"
+              "TUPLTYPE RGB_ALPHA\nENDHDR\n",
+              image.width, image.height, deep ? 65535 : 255) < 0) {
+    return false;
+  }
+  size_t rowBytes = (size_t)image.width * (deep ? 8 : 4);
+  std::vector<uint8_t> packed(rowBytes);
+  std::vector<uint32_t> abgr(deep ? 0 : image.width);
+  for (int y = 0; y < image.height; y++) {
+    uint8_t *out = packed.data();
+    if (deep) {
+      // PAM samples are most significant byte first
+      const PixelRGBA16 *pixels = (const PixelRGBA16 *)((
+          const uint8_t *)image.pixels + (size_t)y * image.stride);
+      for (int x = 0; x < image.width; x++) {
+        for (uint16_t channel :
+             {pixels[x].r, pixels[x].g, pixels[x].b, pixels[x].a}) {
+          *out++ = channel >> 8;
+          *out++ = channel;
+        }
+      }
+    } else {
+      rowToABGR(image, y, abgr.data());
+      for (int x = 0; x < image.width; x++) {
+        *out++ = abgr[x];
+        *out++ = abgr[x] >> 8;
+        *out++ = abgr[x] >> 16;
+        *out++ = abgr[x] >> 24;
+      }
+    }
+    if (fwrite(packed.data(), 1, rowBytes, file) != rowBytes) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Private helper to read a PAM file into pixels. Gray images become RGB, and
+// ones without alpha are opaque. Returns false on failure
+static bool loadPam(FILE *file, std::vector<uint8_t> &pixels,
+                    ImageView &view) {
+  char line[PAM_LINE_LENGTH];
+  if (fgets(line, sizeof(line), file) == NULL || strcmp(line, "P7\n") != 0) {
+    return false;
+  }
+  long width = 0, height = 0, depth = 0, maxValue = 0;
+  bool ended = false;
+  while (!ended && fgets(line, sizeof(line), file) != NULL) {
+    char key[16];
+    long value;
+    if (line[0] == '#' || sscanf(line, "%15s", key) != 1) {
+      continue; // Comments and blank lines
+    }
+    ended = strcmp(key, "ENDHDR") == 0;
+    if (sscanf(line, "%15s %ld", key, &value) != 2) {
+      continue; // TUPLTYPE, which depth already says enough about
+    }
+    if (strcmp(key, "WIDTH") == 0) {
+      width = value;
+    } else if (strcmp(key, "HEIGHT") == 0) {
+      height = value;
+    } else if (strcmp(key, "DEPTH") == 0) {
+      depth = value;
+    } else if (strcmp(key, "MAXVAL") == 0) {
+      maxValue = value;
+    }
+  }
+  if (!ended || depth < 1 || depth > 4) {
+    return false;
+  }
+  if (maxValue != 255 && maxValue != 65535) {
+    fprintf(stderr, "Can only load PAM images with 8 or 16 bits per "
+                    "channel\n");
+    return false;
+  }
+  bool deep = maxValue == 65535;
+  if (!allocateImage(width, height,
+                     deep ? PIXELFORMAT_RGBA64 : PIXELFORMAT_ABGR8888, pixels,
+                     view)) {
+    return false;
+  }
+
+  // Which sample of a tuple holds each channel: gray is red, green and blue
+  int colorSamples = depth >= 3 ? 3 : 1;
+  bool hasAlpha = depth == 2 || depth == 4;
+  int sampleBytes = deep ? 2 : 1;
+  size_t rowBytes = (size_t)width * depth * sampleBytes;
+  std::vector<uint8_t> packed(rowBytes);
+  for (int y = 0; y < view.height; y++) {
+    if (fread(packed.data(), 1, rowBytes, file) != rowBytes) {
+      return false;
+    }
+    uint8_t *row = pixels.data() + (size_t)y * view.stride;
+    for (int x = 0; x < view.width; x++) {
+      const uint8_t *tuple = packed.data() + (size_t)x * depth * sampleBytes;
+      auto sample = [&](int i) {
+        const uint8_t *bytes = tuple + i * sampleBytes;
+        return deep ? bytes[0] << 8 | bytes[1] : bytes[0];
+      };
+      int r = sample(0);
+      int g = sample(colorSamples == 3 ? 1 : 0);
+      int b = sample(colorSamples == 3 ? 2 : 0);
+      int a = hasAlpha ? sample(colorSamples) : maxValue;
+      if (deep) {
+        ((PixelRGBA16 *)row)[x] = {(uint16_t)r, (uint16_t)g, (uint16_t)b,
+                                   (uint16_t)a};
+      } else {
+        ((uint32_t *)row)[x] = abgrPixel(r, g, b, a);
+      }
+    }
+  }
+  return true;
+}
+
+// Private helper to write image to file as a raw image. Returns false on
+// failure
+static bool saveRaw(FILE *file, const ImageView &image) {
+  RawImageHeader header;
+  memcpy(header.magic, RAW_IMAGE_MAGIC, sizeof(header.magic));
+  header.version = RAW_IMAGE_VERSION;
+  header.width = image.width;
+  header.height = image.height;
+  header.format = image.format;
+  if (fwrite(&header, sizeof(header), 1, file) != 1) {
+    return false;
+  }
+  size_t rowBytes = (size_t)image.width * pixelFormatBytes(image.format);
+  // Rows with no gap between them are written all at once
+  if (rowBytes == (size_t)image.stride) {
+    return fwrite(image.pixels, rowBytes, image.height, file) ==
+           (size_t)image.height;
+  }
+  for (int y = 0; y < image.height; y++) {
+    if (fwrite((const uint8_t *)image.pixels + (size_t)y * image.stride, 1,
+               rowBytes, file) != rowBytes) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Private helper to read a raw image file into pixels. Returns false on
+// failure
+static bool loadRaw(FILE *file, std::vector<uint8_t> &pixels,
+                    ImageView &view) {
+  RawImageHeader header;
+  if (fread(&header, sizeof(header), 1, file) != 1 ||
+      memcmp(header.magic, RAW_IMAGE_MAGIC, sizeof(header.magic)) != 0) {
+    return false;
+  }
+  if (header.version != RAW_IMAGE_VERSION ||
+      header.format > PIXELFORMAT_RGBA128_FLOAT) {
+    fprintf(stderr, "Raw image is from another version of this program\n");
+    return false;
+  }
+  return allocateImage(header.width, header.height,
+                       (PixelFormat)header.format, pixels, view) &&
+         fread(pixels.data(), 1, pixels.size(), file) == pixels.size();
+}
+
+bool saveFastImage(const std::string &path, const ImageView &image) {
+  FastImageType type = fastImageType(path);
+  if (type == FAST_IMAGE_NONE) {
+    fprintf(stderr, "%s is not a .qoi, .pam or .rgba file\n", path.c_str());
+    return false;
+  }
+  if (type != FAST_IMAGE_RAW && image.format == PIXELFORMAT_RGBA128_FLOAT) {
+    fprintf(stderr, "Floating point images can only be saved as .rgba\n");
+    return false;
+  }
+  FILE *file = fopen(path.c_str(), "wb");
+  if (file == NULL) {
+    fprintf(stderr, "Could not open %s\n", path.c_str());
+    return false;
+  }
+  bool saved = type == FAST_IMAGE_QOI   ? saveQoi(file, image)
+               : type == FAST_IMAGE_PAM ? savePam(file, image)
+                                        : saveRaw(file, image);
+  // Data may still be buffered, only closing shows if it could be written
+  saved = fclose(file) == 0 && saved;
+  if (!saved) {
+    fprintf(stderr, "Could not save %s\n", path.c_str());
+  }
+  return saved;
+}
+
+bool loadFastImage(const std::string &path, std::vector<uint8_t> &pixels,
+                   ImageView &view) {
+  FastImageType type = fastImageType(path);
+  if (type == FAST_IMAGE_NONE) {
+    fprintf(stderr, "%s is not a .qoi, .pam or .rgba file\n", path.c_str());
+    return false;
+  }
+  FILE *file = fopen(path.c_str(), "rb");
+  if (file == NULL) {
+    fprintf(stderr, "Could not open %s\n", path.c_str());
+    return false;
+  }
+  bool loaded = type == FAST_IMAGE_QOI   ? loadQoi(file, pixels, view)
+                : type == FAST_IMAGE_PAM ? loadPam(file, pixels, view)
+                                         : loadRaw(file, pixels, view);
+  fclose(file);
+  if (!loaded) {
+    fprintf(stderr, "Could not load %s\n", path.c_str());
+  }
+  return loaded;
+}
+
+void convertToABGR8888(const ImageView &image, const ImageView &abgr) {
+  for (int y = 0; y < image.height; y++) {
+    rowToABGR(image, y,
+              (uint32_t *)((uint8_t *)abgr.pixels + (size_t)y * abgr.stride));
+  }
+}
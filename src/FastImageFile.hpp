@@ -0,0 +1,51 @@
+/*
+ * Image files that are quick to write and read back, for handing images from
+ * one pass of a pipeline to the next. They need no other libraries, so the
+ * library, the GUI and the command line can all use them. The type of a file
+ * is chosen by its extension:
+ *
+ * - .qoi, the Quite OK Image format. Lossless and many times faster than
+ *   png, but not as small. Only has 8 bits per channel.
+ * - .pam, the netpbm arbitrary map. Uncompressed, with 8 or 16 bits per
+ *   channel.
+ * - .rgba, a small header and then the pixels as they are in memory, in any
+ *   PixelFormat. Deeper images keep every bit, and saving or loading is a
+ *   single copy, so it is as fast as the disk allows.
+ */
+
+#ifndef FASTIMAGEFILE_HPP_
+#define FASTIMAGEFILE_HPP_
+
+#include "ImageView.hpp"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+enum FastImageType {
+  FAST_IMAGE_NONE, // Not one of these, such as a png
+  FAST_IMAGE_QOI,
+  FAST_IMAGE_PAM,
+  FAST_IMAGE_RAW
+};
+
+// The type of image file path is, from its extension
+FastImageType fastImageType(const std::string &path);
+
+// Save image to path as the type its extension names. 16 bit channels are cut
+// to 8 in QOI files, and floating point images can only be saved raw. Returns
+// false on failure
+bool saveFastImage(const std::string &path, const ImageView &image);
+
+// Load the image at path, of the type its extension names, into pixels, with
+// view set to show them. QOI and 8 bit PAM images are loaded in
+// PIXELFORMAT_ABGR8888, 16 bit PAM images in PIXELFORMAT_RGBA64, and raw ones
+// in the format they were saved in. Returns false on failure
+bool loadFastImage(const std::string &path, std::vector<uint8_t> &pixels,
+                   ImageView &view);
+
+// Copy image into abgr, an image of the same size in PIXELFORMAT_ABGR8888,
+// such as one to show on screen. Deeper channels are cut to 8 bits, and
+// floating point ones clamped to 0 to 1 first
+void convertToABGR8888(const ImageView &image, const ImageView &abgr);
+
+#endif // FASTIMAGEFILE_HPP_
@@ -2,6 +2,8 @@
 #include "ImGui_ImageZoomable.hpp"
 #include "imgui.h"
 #include "imgui_impl_sdlrenderer2.h"
+#include <algorithm>
+#include <cstdio>
 
 // Render the entire window
 void render(SDL_Renderer *renderer) {
@@ -163,3 +165,31 @@ SDL_Surface *SDL_ConvertSurfaceFormat_MemSafe(SDL_Surface *src,
   src = NULL;
   return new_surface;
 }
+
+SDL_Surface *downscaleSurface(SDL_Surface *surface, int maxSide) {
+  if (surface == NULL) {
+    return NULL;
+  }
+  double scale = std::min(1.0, (double)maxSide / std::max(surface->w,
+                                                           surface->h));
+  int width = std::max(1, (int)(surface->w * scale));
+  int height = std::max(1, (int)(surface->h * scale));
+  SDL_Surface *scaled = SDL_CreateRGBSurfaceWithFormat(
+      0, width, height, surface->format->BitsPerPixel,
+      surface->format->format);
+  if (scaled == NULL) {
+    return NULL;
+  }
+  // Copy the pixels as they are, instead of blending them onto scaled
+  SDL_BlendMode blendMode;
+  SDL_GetSurfaceBlendMode(surface, &blendMode);
+  SDL_SetSurfaceBlendMode(surface, SDL_BLENDMODE_NONE);
+  int result = SDL_BlitScaled(surface, NULL, scaled, NULL);
+  SDL_SetSurfaceBlendMode(surface, blendMode);
+  if (result != 0) {
+    fprintf(stderr, "downscaleSurface: %s\n", SDL_GetError());
+    SDL_FreeSurface(scaled);
+    return NULL;
+  }
+  return scaled;
+}
@@ -56,4 +56,9 @@ SDL_Texture *updateTexture(SDL_Renderer *renderer, SDL_Surface *surface,
 SDL_Surface *SDL_ConvertSurfaceFormat_MemSafe(SDL_Surface *src,
                                               const Uint32 fmt);
 
+// Make a copy of surface, in the same format, scaled down so that neither side
+// is longer than maxSide. Surfaces already small enough are copied as is.
+// Returns NULL if surface is NULL or another error occurs
+SDL_Surface *downscaleSurface(SDL_Surface *surface, int maxSide);
+
 #endif // IMGUI_SDL2_HELPERS_HPP_
@@ -0,0 +1,126 @@
+/*
+ * A view of an image held in memory owned by someone else, so that the sorter
+ * can work on any buffer of pixels (an SDL_Surface, a decoded file, a frame
+ * from a video...) without depending on the library that made it.
+ */
+
+#ifndef IMAGEVIEW_HPP_
+#define IMAGEVIEW_HPP_
+
+#include <cstddef>
+#include <cstdint>
+
+// Layouts of a pixel. The 32 bit ones are named from the most to the least
+// significant byte, the deeper ones list their channels in memory order.
+// These match the SDL_PIXELFORMAT values of the same name (the deeper ones
+// are only in SDL3).
+enum PixelFormat {
+  PIXELFORMAT_ABGR8888, // Red in the lowest byte, what the sorter prefers
+  PIXELFORMAT_ARGB8888,
+  PIXELFORMAT_RGBA8888,
+  PIXELFORMAT_BGRA8888,
+  PIXELFORMAT_RGBA64,       // A PixelRGBA16
+  PIXELFORMAT_RGBA128_FLOAT // A PixelRGBA32F
+};
+
+// A pixel of PIXELFORMAT_RGBA64, 16 bits per channel
+struct PixelRGBA16 {
+  uint16_t r;
+  uint16_t g;
+  uint16_t b;
+  uint16_t a;
+};
+
+// A pixel of PIXELFORMAT_RGBA128_FLOAT. Colors are 0 to 1, but may go past
+// either end (as in HDR images)
+struct PixelRGBA32F {
+  float r;
+  float g;
+  float b;
+  float a;
+};
+
+// Bytes taken by a pixel of format
+inline int pixelFormatBytes(PixelFormat format) {
+  switch (format) {
+  case PIXELFORMAT_RGBA64:
+    return sizeof(PixelRGBA16);
+  case PIXELFORMAT_RGBA128_FLOAT:
+    return sizeof(PixelRGBA32F);
+  default:
+    return sizeof(uint32_t);
+  }
+}
+
+// How far each channel is shifted up within a pixel of some PixelFormat
+struct PixelFormatShifts {
+  int r;
+  int g;
+  int b;
+  int a;
+};
+
+inline PixelFormatShifts pixelFormatShifts(PixelFormat format) {
+  switch (format) {
+  case PIXELFORMAT_ARGB8888:
+    return {16, 8, 0, 24};
+  case PIXELFORMAT_RGBA8888:
+    return {24, 16, 8, 0};
+  case PIXELFORMAT_BGRA8888:
+    return {8, 16, 24, 0};
+  case PIXELFORMAT_ABGR8888:
+  default:
+    return {0, 8, 16, 24};
+  }
+}
+
+// True if format has more than 8 bits per channel
+inline bool isDeepFormat(PixelFormat format) {
+  return format == PIXELFORMAT_RGBA64 || format == PIXELFORMAT_RGBA128_FLOAT;
+}
+
+// Get the colors of pixel, where shifts are from pixelFormatShifts
+inline void getRGB(uint32_t pixel, const PixelFormatShifts &shifts, uint8_t &r,
+                   uint8_t &g, uint8_t &b) {
+  r = pixel >> shifts.r;
+  g = pixel >> shifts.g;
+  b = pixel >> shifts.b;
+}
+
+// Get the colors of deeper pixels, from 0 to 1 (or past it for floats)
+inline void getRGB(const PixelRGBA16 &pixel, double &r, double &g,
+                   double &b) {
+  r = pixel.r / 65535.0;
+  g = pixel.g / 65535.0;
+  b = pixel.b / 65535.0;
+}
+inline void getRGB(const PixelRGBA32F &pixel, double &r, double &g,
+                   double &b) {
+  r = pixel.r;
+  g = pixel.g;
+  b = pixel.b;
+}
+
+struct ImageView {
+  void *pixels; // uint32_t, PixelRGBA16 or PixelRGBA32F depending on format
+  int width;
+  int height;
+  // Bytes from the start of one row to the next, a multiple of the size of a
+  // pixel
+  int stride;
+  PixelFormat format;
+
+  // Pixels from the start of one row to the next
+  int rowLength() const { return stride / pixelFormatBytes(format); }
+  // The pixels, as PixelT which must be the type format uses
+  template <typename PixelT> PixelT *pixelsOf() const {
+    return (PixelT *)pixels;
+  }
+  // The view of count rows of the image, from firstRow
+  ImageView rows(int firstRow, int count) const {
+    return {(unsigned char *)pixels + (size_t)firstRow * stride, width, count,
+            stride, format};
+  }
+};
+
+#endif // IMAGEVIEW_HPP_
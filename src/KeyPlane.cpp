@@ -0,0 +1,285 @@
+#include "KeyPlane.hpp"
+#include "ColorConversionBatch.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+PixelSorter_value_t KeyPlane::convertColor(ColorConverter *converter,
+                                           uint8_t r, uint8_t g, uint8_t b) {
+  // Divide by 255 to fit into the 0 to 1 range expected by converters
+  PixelSorter_value_t percent = std::round(
+      PRECISION * converter(((double)r) / 255.0, ((double)g) / 255.0,
+                            ((double)b) / 255.0));
+  if (percent < 0 || percent > PRECISION) { // Sanity check
+    fprintf(stderr, "Bad percent for rgb %d %d %d, p %f, %d/%d\n", r, g, b,
+            1.0f * percent / PRECISION, percent, PRECISION);
+  }
+  return percent;
+}
+
+// Clamp percent to the 0 to 1 range, NaN becomes 0
+static double clampPercent(double percent) {
+  return percent > 0 ? std::min(percent, 1.0) : 0.0;
+}
+
+PixelSorter_wideValue_t KeyPlane::convertColorWide(ColorConverter *converter,
+                                                   int keyBits, uint8_t r,
+                                                   uint8_t g, uint8_t b) {
+  int maxKey = (1 << keyBits) - 1;
+  double percent = converter(((double)r) / 255.0, ((double)g) / 255.0,
+                             ((double)b) / 255.0);
+  // Clamp, so that a converter slightly out of range can not wrap around
+  return std::round(maxKey * clampPercent(percent));
+}
+
+// Convert a row of count pixels with more than 8 bits per channel to keys from
+// 0 to maxKey. Float colors past either end of 0 to 1 are clamped first, as
+// converters only expect colors in that range
+template <typename PixelT, typename KeyT>
+static void convertDeepRow(const PixelT *pixels, KeyT *keys, int count,
+                           ColorConverter *converter, int maxKey) {
+  double r, g, b; // Individual color values
+  for (int i = 0; i < count; i++) {
+    getRGB(pixels[i], r, g, b);
+    double percent =
+        converter(clampPercent(r), clampPercent(g), clampPercent(b));
+    keys[i] = std::round(maxKey * clampPercent(percent));
+  }
+}
+
+// Convert a row of count pixels to their values
+void convertRow(const PixelSorter_Pixel_t *pixels, PixelSorter_value_t *keys,
+                int count, ColorConverter *converter,
+                const PixelFormatShifts &shifts) {
+  uint8_t r, g, b; // Individual color values
+  for (int i = 0; i < count; i++) {
+    getRGB(pixels[i], shifts, r, g, b);
+    keys[i] = KeyPlane::convertColor(converter, r, g, b);
+  }
+}
+
+// Convert a row of count pixels to their values by looking them up in table
+void convertRowTable(const PixelSorter_Pixel_t *pixels,
+                     PixelSorter_value_t *keys, int count,
+                     const ColorTable *table, PixelFormat format) {
+  if (format == PIXELFORMAT_ABGR8888) {
+    // The low 24 bits of the pixel are already the index into the table
+    const PixelSorter_value_t *values = table->data();
+    for (int i = 0; i < count; i++) {
+      keys[i] = values[pixels[i] & COLORTABLE_INDEX_MASK];
+    }
+    return;
+  }
+  PixelFormatShifts shifts = pixelFormatShifts(format);
+  uint8_t r, g, b; // Individual color values
+  for (int i = 0; i < count; i++) {
+    getRGB(pixels[i], shifts, r, g, b);
+    keys[i] = table->lookup(r, g, b);
+  }
+}
+
+// Convert a row of count pixels to their values with an integer converter
+void convertRowInteger(const PixelSorter_Pixel_t *pixels,
+                       PixelSorter_value_t *keys, int count,
+                       IntegerColorConverter *converter,
+                       const PixelFormatShifts &shifts) {
+  uint8_t r, g, b; // Individual color values
+  for (int i = 0; i < count; i++) {
+    getRGB(pixels[i], shifts, r, g, b);
+    keys[i] = converter(r, g, b);
+  }
+}
+
+template <typename KeyT>
+bool KeyPlane::convertDeepRows(const ImageView &image, KeyT *keys,
+                               ColorConverter *converter, int maxKey,
+                               ThreadPool *pool, const SortProgress *progress,
+                               const SortPaging *paging) {
+  int rowLength = image.rowLength();
+  // Pick the type of pixel once, the rows are then converted without checking
+  if (image.format == PIXELFORMAT_RGBA64) {
+    const PixelRGBA16 *pixels = image.pixelsOf<PixelRGBA16>();
+    return convertRows(image, sizeof(KeyT), pool, progress, paging, [&](int y) {
+      size_t rowStart = (size_t)y * rowLength;
+      convertDeepRow(pixels + rowStart, keys + rowStart, image.width,
+                     converter, maxKey);
+    });
+  }
+  const PixelRGBA32F *pixels = image.pixelsOf<PixelRGBA32F>();
+  return convertRows(image, sizeof(KeyT), pool, progress, paging, [&](int y) {
+    size_t rowStart = (size_t)y * rowLength;
+    convertDeepRow(pixels + rowStart, keys + rowStart, image.width, converter,
+                   maxKey);
+  });
+}
+
+bool KeyPlane::isCached(const ImageView &image, ColorConverter *converter,
+                        int keyBits) const {
+  return valid && image.pixels == pixels && image.width == width &&
+         image.height == height && image.stride == stride &&
+         image.format == format && converter == this->converter &&
+         keyBits == this->keyBits;
+}
+
+template <typename KeyT>
+KeyT *KeyPlane::storage(std::vector<KeyT> &owned, size_t count) {
+  if (buffer != NULL && count * sizeof(KeyT) <= bufferBytes) {
+    // Free any memory of its own, the buffer is there to save it
+    std::vector<KeyT>().swap(owned);
+    keyData = buffer;
+  } else {
+    owned.resize(count);
+    keyData = owned.data();
+  }
+  return (KeyT *)keyData;
+}
+
+void KeyPlane::setCached(const ImageView &image, ColorConverter *converter,
+                         int keyBits) {
+  valid = true;
+  pixels = image.pixels;
+  width = image.width;
+  height = image.height;
+  stride = image.stride;
+  format = image.format;
+  this->converter = converter;
+  this->keyBits = keyBits;
+}
+
+template <typename RowConverter>
+bool KeyPlane::convertRows(const ImageView &image, size_t keyBytes,
+                           ThreadPool *pool, const SortProgress *progress,
+                           const SortPaging *paging, RowConverter convertRow) {
+  auto convertRange = [&](int firstRow, int endRow, int worker) {
+    for (int y = firstRow; y < endRow; y++) {
+      if (progress != NULL && progress->isCancelled()) {
+        return;
+      }
+      convertRow(y);
+    }
+  };
+  // Each row pages in its pixels and keys
+  int chunkRows = image.height;
+  if (paging != NULL) {
+    size_t rowBytes = image.stride + (size_t)image.rowLength() * keyBytes;
+    chunkRows = std::max<size_t>(
+        1, std::min<size_t>(paging->residentBytes / rowBytes, image.height));
+  }
+  for (int firstRow = 0; firstRow < image.height; firstRow += chunkRows) {
+    int endRow = std::min(image.height, firstRow + chunkRows);
+    int rows = endRow - firstRow;
+    if (pool == NULL) {
+      convertRange(firstRow, endRow, 0);
+    } else {
+      pool->parallelFor(firstRow, endRow, rows / (pool->size() * 4) + 1,
+                        convertRange);
+    }
+    if (paging != NULL && paging->releasePages) {
+      paging->releasePages();
+    }
+  }
+  if (progress != NULL && progress->isCancelled()) {
+    valid = false; // Some rows were never converted
+    return false;
+  }
+  return true;
+}
+
+const PixelSorter_value_t *
+KeyPlane::update(const ImageView &image, ColorConverter *converter,
+                 IntegerColorConverter *integerConverter,
+                 const ColorTable *table, ThreadPool *pool,
+                 const SortProgress *progress, const SortPaging *paging) {
+  if (isCached(image, converter, 8)) {
+    // Nothing changed, reuse the cached values
+    return (const PixelSorter_value_t *)keyData;
+  }
+
+  int rowLength = image.rowLength();
+  PixelSorter_value_t *keys =
+      storage(this->keys, (size_t)rowLength * image.height);
+  if (isDeepFormat(image.format)) {
+    if (!convertDeepRows(image, keys, converter, PRECISION, pool, progress,
+                         paging)) {
+      return NULL;
+    }
+    setCached(image, converter, 8);
+    return keys;
+  }
+  // Batch converters only understand the default format
+  BatchConverter *batchConverter = NULL;
+  if (integerConverter != NULL && image.format == PIXELFORMAT_ABGR8888) {
+    batchConverter = ColorConversion::getBatchConverter(integerConverter);
+  }
+  PixelFormatShifts shifts = pixelFormatShifts(image.format);
+
+  auto convertImageRow = [&](int y) {
+    const PixelSorter_Pixel_t *rowPixels =
+        image.pixelsOf<PixelSorter_Pixel_t>() + (size_t)y * rowLength;
+    PixelSorter_value_t *rowKeys = keys + (size_t)y * rowLength;
+    if (batchConverter != NULL) {
+      batchConverter(rowPixels, rowKeys, image.width);
+    } else if (integerConverter != NULL) {
+      convertRowInteger(rowPixels, rowKeys, image.width, integerConverter,
+                        shifts);
+    } else if (table != NULL) {
+      convertRowTable(rowPixels, rowKeys, image.width, table, image.format);
+    } else {
+      convertRow(rowPixels, rowKeys, image.width, converter, shifts);
+    }
+  };
+  if (!convertRows(image, sizeof(PixelSorter_value_t), pool, progress, paging,
+                   convertImageRow)) {
+    return NULL;
+  }
+  setCached(image, converter, 8);
+  return keys;
+}
+
+const PixelSorter_wideValue_t *
+KeyPlane::updateWide(const ImageView &image, ColorConverter *converter,
+                     int keyBits, ThreadPool *pool,
+                     const SortProgress *progress, const SortPaging *paging) {
+  if (isCached(image, converter, keyBits)) {
+    // Nothing changed, reuse the cached values
+    return (const PixelSorter_wideValue_t *)keyData;
+  }
+
+  int rowLength = image.rowLength();
+  PixelSorter_wideValue_t *wideKeys =
+      storage(this->wideKeys, (size_t)rowLength * image.height);
+  if (isDeepFormat(image.format)) {
+    if (!convertDeepRows(image, wideKeys, converter, (1 << keyBits) - 1, pool,
+                         progress, paging)) {
+      return NULL;
+    }
+    setCached(image, converter, keyBits);
+    return wideKeys;
+  }
+  PixelFormatShifts shifts = pixelFormatShifts(image.format);
+
+  auto convertImageRow = [&](int y) {
+    const PixelSorter_Pixel_t *rowPixels =
+        image.pixelsOf<PixelSorter_Pixel_t>() + (size_t)y * rowLength;
+    PixelSorter_wideValue_t *rowKeys = wideKeys + (size_t)y * rowLength;
+    uint8_t r, g, b; // Individual color values
+    for (int i = 0; i < image.width; i++) {
+      getRGB(rowPixels[i], shifts, r, g, b);
+      rowKeys[i] = convertColorWide(converter, keyBits, r, g, b);
+    }
+  };
+  if (!convertRows(image, sizeof(PixelSorter_wideValue_t), pool, progress,
+                   paging, convertImageRow)) {
+    return NULL;
+  }
+  setCached(image, converter, keyBits);
+  return wideKeys;
+}
+
+void KeyPlane::invalidate() { valid = false; }
+
+void KeyPlane::useBuffer(void *buffer, size_t bytes) {
+  this->buffer = buffer;
+  bufferBytes = buffer == NULL ? 0 : bytes;
+  valid = false; // The cached keys may be in the old buffer
+}
@@ -0,0 +1,110 @@
+/*
+ * A cache of the value (key) each pixel of an image is sorted by.
+ *
+ * Converting a pixel to its value is the most expensive part of sorting, but
+ * the values only depend on the image and the converter, not on the angle or
+ * the range. The key plane converts every pixel once, and keeps the result
+ * until the image or converter changes.
+ */
+
+#ifndef KEYPLANE_HPP_
+#define KEYPLANE_HPP_
+
+#include "ColorConversion.hpp"
+#include "ColorConversionInteger.hpp"
+#include "ColorTable.hpp"
+#include "ImageView.hpp"
+#include "PixelSorter.hpp"
+#include "ThreadPool.hpp"
+#include <vector>
+
+class KeyPlane {
+public:
+  /*
+   * Get the value of every pixel of image, in the same layout as its pixels
+   * (one value per pixel, rows image.rowLength() apart).
+   * The values are only recomputed if the image or converter differ from the
+   * last call, or invalidate was called since then.
+   * integerConverter is the exact integer version of converter, used in its
+   * place when not NULL (see ColorConversionInteger.hpp). Otherwise table is
+   * used to look up the values when it is not NULL (see ColorTable.hpp).
+   * Both only take 8 bit colors, so images of a deeper format (see
+   * isDeepFormat) are always converted with converter.
+   * If pool is not NULL the rows are converted across its workers.
+   * If paging is not NULL the rows are converted in chunks that keep to its
+   * budget, for images (and buffers) in memory mapped files.
+   * Returns NULL if progress is cancelled before every row is converted.
+   */
+  const PixelSorter_value_t *update(const ImageView &image,
+                                    ColorConverter *converter,
+                                    IntegerColorConverter *integerConverter,
+                                    const ColorTable *table,
+                                    ThreadPool *pool = NULL,
+                                    const SortProgress *progress = NULL,
+                                    const SortPaging *paging = NULL);
+
+  /*
+   * The same as update, but with keys of keyBits bits (12 or 16, see
+   * PixelSorter::keyBitsSupported) for smoother gradients. Always converts
+   * with converter, as integer converters and tables only give 8 bits.
+   */
+  const PixelSorter_wideValue_t *
+  updateWide(const ImageView &image, ColorConverter *converter, int keyBits,
+             ThreadPool *pool = NULL, const SortProgress *progress = NULL,
+             const SortPaging *paging = NULL);
+
+  // Forget the cached values. Must be called when the pixels of the image are
+  // changed or replaced, as the same pointer may be reused for a new image
+  void invalidate();
+
+  // Keep the values in the bytes at buffer (such as a memory mapped file)
+  // instead of memory of its own, when they fit. Forgets the cached values.
+  // The buffer must outlive its use, useBuffer(NULL, 0) stops using it
+  void useBuffer(void *buffer, size_t bytes);
+
+  // The value of a single color with converter, the same as sorting uses
+  static PixelSorter_value_t convertColor(ColorConverter *converter, uint8_t r,
+                                          uint8_t g, uint8_t b);
+  // The same, as a key of keyBits bits
+  static PixelSorter_wideValue_t convertColorWide(ColorConverter *converter,
+                                                  int keyBits, uint8_t r,
+                                                  uint8_t g, uint8_t b);
+
+private:
+  bool isCached(const ImageView &image, ColorConverter *converter,
+                int keyBits) const;
+  void setCached(const ImageView &image, ColorConverter *converter,
+                 int keyBits);
+  // Get room for count keys, in buffer if they fit there, otherwise in owned
+  template <typename KeyT>
+  KeyT *storage(std::vector<KeyT> &owned, size_t count);
+  // Call convertRow(y) for every row of image, with keys of keyBytes bytes
+  // each. Returns false if cancelled
+  template <typename RowConverter>
+  bool convertRows(const ImageView &image, size_t keyBytes, ThreadPool *pool,
+                   const SortProgress *progress, const SortPaging *paging,
+                   RowConverter convertRow);
+  // Convert every pixel of image, which must be of a deep format, into keys
+  // from 0 to maxKey with converter. Returns false if cancelled
+  template <typename KeyT>
+  bool convertDeepRows(const ImageView &image, KeyT *keys,
+                       ColorConverter *converter, int maxKey, ThreadPool *pool,
+                       const SortProgress *progress, const SortPaging *paging);
+
+  std::vector<PixelSorter_value_t> keys;
+  std::vector<PixelSorter_wideValue_t> wideKeys;
+  void *buffer = NULL; // Set by useBuffer
+  size_t bufferBytes = 0;
+  void *keyData = NULL; // Where the cached keys are, keys, wideKeys or buffer
+  bool valid = false;
+  // What keys were computed from
+  const void *pixels = NULL;
+  int width = 0;
+  int height = 0;
+  int stride = 0;
+  PixelFormat format = PIXELFORMAT_ABGR8888;
+  ColorConverter *converter = NULL;
+  int keyBits = 8; // 8 if keys holds the values, otherwise wideKeys does
+};
+
+#endif // KEYPLANE_HPP_
@@ -2,10 +2,11 @@
 #include "LineInterpolator.hpp"
 #include <cmath>
 #include <cstdio>
+#include <cstdlib>
 
 using LineCollision::point_doubles;
+using LineCollision::LineRuns;
 using LineCollision::point_ints;
-using LineCollision::pointQueue;
 
 // Return the intersection of the line from x,y to the center of min[XY] max[XY]
 point_doubles LineCollision::pointOnRect(double x, double y, double minX,
@@ -50,9 +51,10 @@ point_doubles LineCollision::pointOnRect(double x, double y, double minX,
 // Generate a Bresenham's line at angle that goes from origin to any edge of the
 // rectangle. With the origin being (0, 0), the line starts at the origin, and
 // the rectangle is centered on the origin
-pointQueue LineCollision::generateLineQueueForRect(double &angle, int width,
-                                                   int height,
-                                                   BresenhamsArguments &args) {
+void LineCollision::generateLineRunsForRect(double &angle, int width,
+                                            int height,
+                                            BresenhamsArguments &args,
+                                            LineRuns &runs) {
   if (angle == 360) {
     angle = 0;
   }
@@ -75,10 +77,31 @@ pointQueue LineCollision::generateLineQueueForRect(double &angle, int width,
   bresenham_interpolator *interpolator =
       LineInterpolator::get_interpolator(args.deltaX, args.deltaY);
 
-  /* Fill queue with points on line */
-  pointQueue points;
-  do {
-    points.push(std::make_pair(args.currentX, args.currentY));
-  } while (interpolator(args));
-  return points;
+  /* Find the axes the line steps along */
+  // Octants 0, 3, 4 and 7 step along X every point, the others along Y
+  typedef LineInterpolator LI;
+  runs.majorIsX = interpolator == &LI::interpolate_bresenhams_O0 ||
+                  interpolator == &LI::interpolate_bresenhams_O3 ||
+                  interpolator == &LI::interpolate_bresenhams_O4 ||
+                  interpolator == &LI::interpolate_bresenhams_O7;
+  int majorDelta = runs.majorIsX ? args.deltaX : args.deltaY;
+  int minorDelta = runs.majorIsX ? args.deltaY : args.deltaX;
+  runs.majorStep = majorDelta < 0 ? -1 : 1;
+  runs.minorStep = minorDelta < 0 ? -1 : 1;
+
+  /* Walk the line, a new run starts at each step along the minor axis */
+  int *minor = runs.majorIsX ? &args.currentY : &args.currentX;
+  int lastMinor = *minor;
+  runs.numPoints = 1;
+  runs.starts.clear();
+  runs.starts.reserve(std::abs(minorDelta) + 2);
+  runs.starts.push_back(0);
+  while (interpolator(args)) {
+    if (*minor != lastMinor) {
+      runs.starts.push_back(runs.numPoints);
+      lastMinor = *minor;
+    }
+    runs.numPoints++;
+  }
+  runs.starts.push_back(runs.numPoints);
 }
@@ -5,8 +5,8 @@
  * Calculate the line that would collide with a given rectangle
  */
 #include "LineInterpolator.hpp"
-#include <queue>
 #include <utility>
+#include <vector>
 namespace LineCollision {
 
 // typedef struct {
@@ -17,12 +17,31 @@ namespace LineCollision {
 // using point_doubles =
 typedef std::pair<double, double> point_doubles;
 typedef std::pair<int, int> point_ints;
-typedef std::queue<point_ints> pointQueue;
+
+// A line stored as runs of points that only step along its major axis, the
+// axis it changes the most along. Every point is one step along the major axis
+// from the point before it, and the first point of each run after the first is
+// also one step along the minor axis. A line at a shallow angle is a few long
+// runs, instead of a pair of coordinates for every point
+struct LineRuns {
+  int numPoints = 0;
+  bool majorIsX = true;
+  int majorStep = 1; // 1 or -1
+  int minorStep = 1; // 1 or -1
+  // Index of the first point of each run, followed by numPoints. Run r is the
+  // points from starts[r] up to starts[r + 1]
+  std::vector<int> starts;
+
+  int numRuns() const { return (int)starts.size() - 1; }
+};
 
 point_doubles pointOnRect(double x, double y, double minX, double maxX,
                           double minY, double maxY);
-pointQueue generateLineQueueForRect(double &angle, int width, int height,
-                                    BresenhamsArguments &args);
+// Fill runs with the line at angle that reaches every edge of a width by
+// height rectangle, starting at (0, 0). Reusing the same runs only allocates
+// when the line has more runs than before
+void generateLineRunsForRect(double &angle, int width, int height,
+                             BresenhamsArguments &args, LineRuns &runs);
 } // namespace Rename
 
 #endif //  LINECOLLISION_HPP_
@@ -1,7 +1,9 @@
 #include "PixelSorter.hpp"
-#include "ColorConversion.hpp"
-#include "SDL_pixels.h"
+#include "LineCollision.hpp"
+#include "LineInterpolator.hpp"
+#include "SortWorkspace.hpp"
 #include "global.hpp"
+#include <algorithm>
 #include <cstdint>
 #include <cstdio>
 #include <cstdlib>
@@ -9,31 +11,148 @@
 
 // How many unique values can there be, also how precise are our values
 #define COUNT_T long
+// How many blocks of lines each worker of a thread pool gets on average
+#define LINE_BLOCKS_PER_WORKER 8
+// How many neighbouring lines are walked together when each line steps along Y
+// more than X. 16 pixels are 64 bytes, a whole cache line
+#define LINE_BUNDLE_SIZE 16
+// How many columns are copied into rows at a time when sorting along columns.
+// 16 pixels are 64 bytes, so each row of a strip is a whole cache line
+#define COLUMN_STRIP_WIDTH 16
+// Bands shorter than this are sorted by insertion sort, as clearing and adding
+// up the count of every value costs more than sorting so few pixels
+#define SMALL_BAND_LENGTH 24
+// Wider keys are radix sorted this many bits at a time
+#define RADIX_BITS 8
+// Wide keys that could be counted are still radix sorted in bands shorter than
+// the number of values they can have divided by this, as clearing and adding
+// up every count then costs more
+#define RADIX_BAND_DIVISOR 8
 
-// Sort a band of pixels.
-void sortBand(PixelSorter_Pixel_t *&inputPixels,
-              PixelSorter_Pixel_t *&outputPixels, PixelSorter_value_t *values,
-              int *pixelIndexes, int numPoints, int width, int height,
-              int bandStartIndex, int bandEndIndex) {
-  static const COUNT_T countLen = PRECISION + 1;
-  // Count will store the count of each number
-  COUNT_T *count = (COUNT_T *)calloc(countLen, sizeof(COUNT_T));
-  if (count == NULL) {
-    fprintf(stderr, "Could not create a count array. Image may be too big\n");
+// About the size of a page of memory, the least that touching any part of a
+// memory mapped image pages in
+#define PAGE_BYTES 4096
+
+// The largest key with _bits_ bits
+#define KEY_MAX(_bits_) ((1 << (_bits_)) - 1)
+
+// Private helper to sort a band of fewer than SMALL_BAND_LENGTH values, held
+// step apart, by insertion sort. Fills order with the offsets of the values
+// within the band, in sorted order. Equal values end up in the same order as
+// counting sort leaves them, the last along the line first
+template <typename KeyT>
+static void sortSmallBand(const KeyT *values, int step, int length,
+                          int *order) {
+  KeyT sortedValues[SMALL_BAND_LENGTH];
+  for (int i = 0; i < length; i++) {
+    KeyT value = values[i * step];
+    int j = i;
+    // Also move past equal values, so that this one comes before them
+    while (j > 0 && sortedValues[j - 1] >= value) {
+      sortedValues[j] = sortedValues[j - 1];
+      order[j] = order[j - 1];
+      j--;
+    }
+    sortedValues[j] = value;
+    order[j] = i;
+  }
+}
+
+// Private helper to sort a band of length values of Bits bits, held step
+// apart, by LSD radix sort. Fills order with the offsets of the values within
+// the band in sorted order, using scratch (also length long) and count (which
+// must hold 1 << RADIX_BITS counts). Equal values end up in the same order as
+// counting sort leaves them
+template <typename KeyT, int Bits>
+static void radixSortBand(const KeyT *values, int step, int length, int *order,
+                          int *scratch, COUNT_T *count) {
+  // Every pass is stable, so starting from the offsets backwards leaves equal
+  // values the last along the line first
+  int *from = order;
+  int *to = scratch;
+  for (int i = 0; i < length; i++) {
+    from[i] = length - 1 - i;
+  }
+  for (int shift = 0; shift < Bits; shift += RADIX_BITS) {
+    // The last digit may have fewer bits
+    int digitMax = KEY_MAX(std::min(RADIX_BITS, Bits - shift));
+    std::fill(count, count + digitMax + 1, 0);
+    for (int i = 0; i < length; i++) {
+      (count[(values[i * step] >> shift) & digitMax])++;
+    }
+    if (count[(values[0] >> shift) & digitMax] == length) {
+      continue; // Every value has the same digit, nothing would move
+    }
+    // Change count[i] to where the first offset with digit i goes
+    COUNT_T position = 0;
+    for (int digit = 0; digit <= digitMax; digit++) {
+      COUNT_T digitCount = count[digit];
+      count[digit] = position;
+      position += digitCount;
+    }
+    for (int i = 0; i < length; i++) {
+      int offset = from[i];
+      to[(count[(values[offset * step] >> shift) & digitMax])++] = offset;
+    }
+    std::swap(from, to);
+  }
+  if (from != order) {
+    std::copy(from, from + length, order);
+  }
+}
+
+// Private helper to sort a band of length values of Bits bits, held step
+// apart, when counting sort would be slower: by insertion sort when the band
+// is short, or by radix sort when the keys have too many values to count
+// (or more than the band has pixels).
+// Fills order (twice length long) with the offsets of the values within the
+// band in sorted order. Returns false if the band should be counting sorted
+template <typename KeyT, int Bits>
+static bool sortBandOrder(const KeyT *values, int step, int length, int *order,
+                          COUNT_T *count) {
+  if (length < SMALL_BAND_LENGTH) {
+    sortSmallBand(values, step, length, order);
+    return true;
+  }
+  if (Bits > PIXELSORTER_COUNTING_BITS ||
+      (Bits > 8 && length < (1 << Bits) / RADIX_BAND_DIVISOR)) {
+    radixSortBand<KeyT, Bits>(values, step, length, order, order + length,
+                              count);
+    return true;
+  }
+  return false;
+}
+
+template <typename PixelT, typename KeyT, int Bits>
+void PixelSorter::sortBand(PixelT *&inputPixels, PixelT *&outputPixels,
+                           KeyT *values, int *pixelIndexes, Count_t *count,
+                           int *order, int numPoints, int width, int height,
+                           int bandStartIndex, int bandEndIndex) {
+  int length = bandEndIndex - bandStartIndex;
+  if (sortBandOrder<KeyT, Bits>(values + bandStartIndex, 1, length, order,
+                                count)) {
+    const int *bandPixelIndexes = pixelIndexes + bandStartIndex;
+    for (int i = 0; i < length; i++) {
+      outputPixels[bandPixelIndexes[i]] =
+          inputPixels[bandPixelIndexes[order[i]]];
+    }
     return;
   }
+
+  static const COUNT_T countLen = KEY_MAX(Bits) + 1;
+  // Count will store the count of each number
+  std::fill(count, count + countLen, 0);
   COUNT_T lineIndex = bandStartIndex;
 
   // Count each value
   for (lineIndex = bandStartIndex; lineIndex < bandEndIndex; lineIndex++) {
-    int pixelIndex = pixelIndexes[lineIndex];
-    PixelSorter_value_t value = values[pixelIndex];
+    KeyT value = values[lineIndex];
     (count[value])++;
   }
 
   // Change count[i] so that count[i] now contains actual
   // position of this value in output surface
-  for (int i = 1; i <= PRECISION; i++) {
+  for (int i = 1; i <= KEY_MAX(Bits); i++) {
     (count[i]) += (count[i - 1]);
   }
 
@@ -41,126 +160,681 @@ void sortBand(PixelSorter_Pixel_t *&inputPixels,
   for (lineIndex = bandStartIndex; lineIndex < bandEndIndex; lineIndex++) {
     int pixelIndex = pixelIndexes[lineIndex]; // Pixel index of lineIndex
     // The line index that the output pixel is at
-    int outputLineIndex = bandStartIndex + (count[values[pixelIndex]] - 1);
+    int outputLineIndex = bandStartIndex + (count[values[lineIndex]] - 1);
     outputPixels[pixelIndexes[outputLineIndex]] = inputPixels[pixelIndex];
-    (count[values[pixelIndex]])--;
+    (count[values[lineIndex]])--;
+  }
+}
+
+// Instantiate sortBand for every kind of pixel and key
+#define INSTANTIATE_SORT_BAND(_pixel_, _key_, _bits_)                          \
+  template void PixelSorter::sortBand<_pixel_, _key_, _bits_>(                 \
+      _pixel_ *&, _pixel_ *&, _key_ *, int *, Count_t *, int *, int, int, int, \
+      int, int);
+#define INSTANTIATE_SORT_BANDS(_pixel_)                                        \
+  INSTANTIATE_SORT_BAND(_pixel_, PixelSorter_value_t, 8)                       \
+  INSTANTIATE_SORT_BAND(_pixel_, PixelSorter_wideValue_t, 12)                  \
+  INSTANTIATE_SORT_BAND(_pixel_, PixelSorter_wideValue_t, 16)
+INSTANTIATE_SORT_BANDS(PixelSorter_Pixel_t)
+INSTANTIATE_SORT_BANDS(PixelRGBA16)
+INSTANTIATE_SORT_BANDS(PixelRGBA32F)
+
+// Private helper to sort a band the same as sortBand, from pixels that were
+// gathered next to each other with the values (both indexed by lineIndex).
+// Only the writes then jump around the image
+template <typename PixelT, typename KeyT, int Bits>
+static void sortGatheredBand(const PixelT *pixels, PixelT *outputPixels,
+                             const KeyT *values, const int *pixelIndexes,
+                             COUNT_T *count, int *order, int bandStartIndex,
+                             int bandEndIndex) {
+  int length = bandEndIndex - bandStartIndex;
+  if (sortBandOrder<KeyT, Bits>(values + bandStartIndex, 1, length, order,
+                                count)) {
+    for (int i = 0; i < length; i++) {
+      outputPixels[pixelIndexes[bandStartIndex + i]] =
+          pixels[bandStartIndex + order[i]];
+    }
+    return;
+  }
+
+  std::fill(count, count + KEY_MAX(Bits) + 1, 0);
+  for (int i = bandStartIndex; i < bandEndIndex; i++) {
+    (count[values[i]])++;
+  }
+  for (int i = 1; i <= KEY_MAX(Bits); i++) {
+    (count[i]) += (count[i - 1]);
+  }
+  for (int i = bandStartIndex; i < bandEndIndex; i++) {
+    int outputLineIndex = bandStartIndex + --(count[values[i]]);
+    outputPixels[pixelIndexes[outputLineIndex]] = pixels[i];
+  }
+}
+
+// The range of i, within [0, count), where first + i * step is within
+// [0, limit). step is 1 or -1. Sets iFirst to count if there is none
+static void clipSteps(int first, int step, int limit, int count, int &iFirst,
+                      int &iEnd) {
+  if (step > 0) {
+    iFirst = std::max(0, -first);
+    iEnd = std::min(count, limit - first);
+  } else {
+    iFirst = std::max(0, first - (limit - 1));
+    iEnd = std::min(count, first + 1);
+  }
+  if (iFirst >= iEnd) {
+    iFirst = iEnd = count;
   }
-  free(count);
 }
 
-// Private helper to sort an individual line
-bool sortEachLine(PixelSorter_Pixel_t *&inputPixels,
-                  PixelSorter_Pixel_t *&outputPixels, point_ints *points,
-                  int numPoints, int width, int height, int deltaX, int deltaY,
-                  int offsetX, int offsetY, int valueMin, int valueMax,
-                  ColorConverter *converter, SDL_PixelFormat *format) {
+// Private helper to find the part of a line that is inside the image. Sets
+// firstIndex to the lineIndex of its first point, and returns the lineIndex
+// just after its last. Both are numPoints if the line misses
+static int clipLine(const LineCollision::LineRuns &line, int width, int height,
+                    int offsetX, int offsetY, int &firstIndex) {
+  int numPoints = line.numPoints;
+  const int *starts = line.starts.data();
+  // The major coordinate changes every point, the minor one every run. Both
+  // only ever change in one direction, so each is inside the image for one
+  // range of the line, and the line is inside where those ranges overlap
+  int majorFirst, majorEnd; // Points with the major coordinate inside
+  clipSteps(line.majorIsX ? offsetX : offsetY, line.majorStep,
+            line.majorIsX ? width : height, numPoints, majorFirst, majorEnd);
+  int minorFirst, minorEnd; // Runs with the minor coordinate inside
+  clipSteps(line.majorIsX ? offsetY : offsetX, line.minorStep,
+            line.majorIsX ? height : width, line.numRuns(), minorFirst,
+            minorEnd);
+  firstIndex = std::max(majorFirst, starts[minorFirst]);
+  int endIndex = std::min(majorEnd, starts[minorEnd]);
+  if (firstIndex >= endIndex) {
+    firstIndex = numPoints;
+    return numPoints; // Missed the image
+  }
+  return endIndex;
+}
+
+// The run of line holding the point at lineIndex
+static int runOfPoint(const LineCollision::LineRuns &line, int lineIndex) {
+  const int *starts = line.starts.data();
+  return std::upper_bound(starts, starts + line.numRuns() + 1, lineIndex) -
+         starts - 1;
+}
+
+// Private helper to find the part of a line that is inside the image, and
+// gather it a run at a time. Fills pixelIndexes and values (indexed by
+// lineIndex) for that part, sets firstIndex to the lineIndex of its first
+// point and returns the lineIndex just after its last. Both are numPoints if
+// the line misses
+template <typename KeyT>
+static int gatherLine(const LineCollision::LineRuns &line, int width,
+                      int height, int rowLength, int offsetX, int offsetY,
+                      const KeyT *keys, int *pixelIndexes, KeyT *values,
+                      int &firstIndex) {
+  int endIndex = clipLine(line, width, height, offsetX, offsetY, firstIndex);
+  if (firstIndex == line.numPoints) {
+    return endIndex;
+  }
+
+  /* Gather the points inside the image, one pointer step per point */
+  const int *starts = line.starts.data();
+  int majorStep = line.majorStep;
+  int minorStep = line.minorStep;
+  int run = runOfPoint(line, firstIndex);
+  int major = (line.majorIsX ? offsetX : offsetY) + firstIndex * majorStep;
+  int minor = (line.majorIsX ? offsetY : offsetX) + run * minorStep;
+  // Pixels between neighbouring points along each axis
+  int pixelStep = line.majorIsX ? majorStep : majorStep * rowLength;
+  int minorPixelStep = line.majorIsX ? minorStep * rowLength : minorStep;
+  int pixelIndex = line.majorIsX ? TWOD_TO_1D(major, minor, rowLength)
+                                 : TWOD_TO_1D(minor, major, rowLength);
+  int lineIndex = firstIndex;
+  while (true) {
+    int runEnd = std::min(starts[run + 1], endIndex);
+    for (; lineIndex < runEnd; lineIndex++) {
+      pixelIndexes[lineIndex] = pixelIndex;
+      values[lineIndex] = keys[pixelIndex];
+      pixelIndex += pixelStep;
+    }
+    if (lineIndex == endIndex) {
+      return endIndex;
+    }
+    // Step onto the next run
+    run++;
+    pixelIndex += minorPixelStep;
+  }
+}
+
+// Private helper to sort a line once gatherLine has filled values and
+// pixelIndexes from firstIndex up to endIndex. If pixels is not NULL it holds
+// the input pixels of the line (indexed by lineIndex), which are then read
+// from there instead of from inputPixels
+template <typename PixelT, typename KeyT, int Bits>
+static void sortGatheredLine(PixelT *&inputPixels, PixelT *&outputPixels,
+                             int numPoints, int width, int height,
+                             int firstIndex, int endIndex, int valueMin,
+                             int valueMax, KeyT *values, int *pixelIndexes,
+                             COUNT_T *count, int *order,
+                             const PixelT *pixels = NULL) {
   /*
-   * For each line:
-   *  while out of bounds: move along line
-   *  while in bounds:
-   *     + While in bounds
+   * For each pixel of the part of the line inside the image:
    *    * if pixel outside range
    *      - if last was in range:
    *        - place sorted pixels onto output
    *      - copy pixel from input to output
    *    * if pixel in range
    *      - add pixel to value map
-   *    * move to next spot
    *  + if was in range
    *    * place sorted pixels onto output
    */
 
   // Starting index of the current band of sortable values
   int bandStartIndex = 0;
-  uint8_t r, g, b; // Individual color values, that will be used later
-  // TODO: make a variable
-
-  PixelSorter_value_t values[width * height]; // pixelIndex to value
-  bool wasLastInBand = false;                 // if the last pixel was in a band
-  // Conversion map from lineIndex to pixelIndex-
-  int *pixelIndexes = (int *)calloc(numPoints, sizeof(int));
-
-  int lineIndex = 0;
-
-  // Advance until lineIndex is actually in the image
-  for (; lineIndex < numPoints; lineIndex++) {
-    int x = points[lineIndex].first + offsetX;
-    int y = points[lineIndex].second + offsetY;
-    if (0 <= x && x < width && 0 <= y && y < height) {
-      break; // We are inside the image, get to it
+  bool wasLastInBand = false; // if the last pixel was in a band
+  // Sort the band from bandStartIndex to bandEndIndex - 1
+  auto sortBandTo = [&](int bandEndIndex) {
+    if (pixels != NULL) {
+      sortGatheredBand<PixelT, KeyT, Bits>(pixels, outputPixels, values,
+                                           pixelIndexes, count, order,
+                                           bandStartIndex, bandEndIndex);
+    } else {
+      PixelSorter::sortBand<PixelT, KeyT, Bits>(
+          inputPixels, outputPixels, values, pixelIndexes, count, order,
+          numPoints, width, height, bandStartIndex, bandEndIndex);
     }
-  }
-
-  if (lineIndex >= numPoints) {
-    return false; // reached numPoints, thus band does not touch image, stop
-  }
+  };
 
   // Loop until we exit the image, or line goes past the image
-  for (; lineIndex < numPoints; lineIndex++) {
-    int x = points[lineIndex].first + offsetX;
-    int y = points[lineIndex].second + offsetY;
-    int pixelIndex = TWOD_TO_1D(x, y, width);
-
-    pixelIndexes[lineIndex] = pixelIndex;
-    if (!(0 <= x && x < width && 0 <= y && y < height)) { // Check for outside
-      if (wasLastInBand) {
-        // Sort from bandStartIndex to lineIndex
-        sortBand(inputPixels, outputPixels, values, pixelIndexes, numPoints,
-                 width, height, bandStartIndex, lineIndex);
-      }
-      wasLastInBand = false;
-      break; // point is out of bounds, no more points to read
-    }
-
-    /* Point must be in bounds at this point */
-    PixelSorter_Pixel_t pixel = inputPixels[pixelIndex];
-    SDL_GetRGB(pixel, format, &r, &g, &b);
-    // Divide by 255 to fit into the 0 to 1 range expected by converters
-    PixelSorter_value_t percent = std::round(
-        PRECISION * converter(((double)r) / 255.0, ((double)g) / 255.0,
-                              ((double)b) / 255.0));
-    if (percent < 0 || percent > PRECISION) { // Sanity check
-      fprintf(stderr, "Bad percent at (%d, %d), rgb %d %d %d, p %f, %d/%d\n", x,
-              y, r, g, b, 1.0f * percent / PRECISION, percent, PRECISION);
-    }
+  for (int lineIndex = firstIndex; lineIndex < endIndex; lineIndex++) {
+    int pixelIndex = pixelIndexes[lineIndex];
+    KeyT percent = values[lineIndex];
 
     // A band is a contiguous list of pixels that are within the min max values
     bool inBand = valueMin <= percent && valueMax >= percent;
     // State: out of band
     if (!inBand) {
       // Copy input to output
-      outputPixels[pixelIndex] = inputPixels[pixelIndex];
+      outputPixels[pixelIndex] =
+          pixels != NULL ? pixels[lineIndex] : inputPixels[pixelIndex];
       if (wasLastInBand) { // If transitioned out of a bad, sort the band
         // Sort the band from bandStartIndex to lineIndex - 1
-        sortBand(inputPixels, outputPixels, values, pixelIndexes, numPoints,
-                 width, height, bandStartIndex, lineIndex);
+        sortBandTo(lineIndex);
       }
       wasLastInBand = false;
     } else {
       if (!wasLastInBand) {         // If it is the start of a band
         bandStartIndex = lineIndex; // Remember starting index
       }
-      // Add current pixel value to values
-      values[pixelIndex] = percent;
       wasLastInBand = true;
     }
   }
   // If was in a band at the end of the line, we must sort
   if (wasLastInBand) {
-    // Sort from bandStartIndex to numPoints - 1
-    sortBand(inputPixels, outputPixels, values, pixelIndexes, numPoints, width,
-             height, bandStartIndex, numPoints - 1);
+    if (endIndex < numPoints) {
+      // Sort from bandStartIndex to endIndex - 1, where the line left
+      sortBandTo(endIndex);
+    } else {
+      // Sort from bandStartIndex to numPoints - 1
+      sortBandTo(numPoints - 1);
+    }
   }
-  free(pixelIndexes);
+}
+
+// Private helper to sort an individual line. Returns false if it missed the
+// image
+template <typename PixelT, typename KeyT, int Bits>
+bool sortEachLine(PixelT *&inputPixels, PixelT *&outputPixels,
+                  const LineCollision::LineRuns &line, int width, int height,
+                  int rowLength, int offsetX, int offsetY, int valueMin,
+                  int valueMax, const KeyT *keys,
+                  SortWorkspace::Buffers &buffers) {
+  int numPoints = line.numPoints;
+  KeyT *values = buffers.valuesOf<KeyT>(); // lineIndex to value
+  // Conversion map from lineIndex to pixelIndex
+  int *pixelIndexes = buffers.pixelIndexes.data();
+
+  int firstIndex = 0;
+  int endIndex = gatherLine(line, width, height, rowLength, offsetX, offsetY,
+                            keys, pixelIndexes, values, firstIndex);
+  if (firstIndex >= numPoints) {
+    return false; // reached numPoints, thus band does not touch image, stop
+  }
+  // Sorting in place would overwrite pixels of the line before they are read,
+  // so read them all first
+  PixelT *pixels = NULL;
+  if (inputPixels == outputPixels) {
+    pixels = buffers.pixelsOf<PixelT>();
+    for (int lineIndex = firstIndex; lineIndex < endIndex; lineIndex++) {
+      pixels[lineIndex] = inputPixels[pixelIndexes[lineIndex]];
+    }
+  }
+  sortGatheredLine<PixelT, KeyT, Bits>(
+      inputPixels, outputPixels, numPoints, width, height, firstIndex,
+      endIndex, valueMin, valueMax, values, pixelIndexes, buffers.count.data(),
+      buffers.order.data(), pixels);
   return true;
 }
 
-void PixelSorter::sort(PixelSorter_Pixel_t *&inputPixels,
-                       PixelSorter_Pixel_t *&outputPixels, point_ints *points,
-                       int numPoints, int width, int height, int startX,
+// Private helper to sort a bundle of up to LINE_BUNDLE_SIZE neighbouring lines
+// starting at (firstX + n, offsetY), for n from 0 up to lines. At any lineIndex
+// the points of these lines are neighbouring pixels of the same row, so the
+// lines are gathered in lock-step and every cache line read is used by all of
+// them, instead of by one line each for steep lines. The input pixels are
+// gathered with the values for the same reason. Each line has numPoints of
+// space in values, pixels and pixelIndexes. Returns false if every line missed
+template <typename PixelT, typename KeyT, int Bits>
+bool sortLineBundle(PixelT *&inputPixels, PixelT *&outputPixels,
+                    const LineCollision::LineRuns &line, int width,
+                    int height, int rowLength, int firstX, int lines,
+                    int offsetY, int valueMin, int valueMax, const KeyT *keys,
+                    SortWorkspace::Buffers &buffers) {
+  int numPoints = line.numPoints;
+  KeyT *values = buffers.valuesOf<KeyT>();
+  PixelT *pixels = buffers.pixelsOf<PixelT>();
+  int *pixelIndexes = buffers.pixelIndexes.data();
+
+  /* Clip every line, and find the points where any of them is inside */
+  int firstIndexes[LINE_BUNDLE_SIZE];
+  int endIndexes[LINE_BUNDLE_SIZE];
+  int bundleFirst = numPoints;
+  int bundleEnd = 0;
+  for (int n = 0; n < lines; n++) {
+    endIndexes[n] =
+        clipLine(line, width, height, firstX + n, offsetY, firstIndexes[n]);
+    if (firstIndexes[n] < numPoints) {
+      bundleFirst = std::min(bundleFirst, firstIndexes[n]);
+      bundleEnd = std::max(bundleEnd, endIndexes[n]);
+    }
+  }
+  if (bundleFirst >= bundleEnd) {
+    return false;
+  }
+
+  /* Gather the lines in lock-step, a row of neighbouring pixels per point */
+  const int *starts = line.starts.data();
+  int run = runOfPoint(line, bundleFirst);
+  int major = bundleFirst * line.majorStep; // Relative to the first point
+  int minor = run * line.minorStep;
+  for (int lineIndex = bundleFirst; lineIndex < bundleEnd; lineIndex++) {
+    if (lineIndex == starts[run + 1]) {
+      run++;
+      minor += line.minorStep;
+    }
+    int x = firstX + (line.majorIsX ? major : minor);
+    int y = offsetY + (line.majorIsX ? minor : major);
+    major += line.majorStep;
+    if (y < 0 || y >= height) {
+      continue;
+    }
+    // The lines whose point is inside the image here
+    int nFirst = std::max(0, -x);
+    int nEnd = std::min(lines, width - x);
+    int pixelIndex = TWOD_TO_1D(x, y, rowLength);
+    for (int n = nFirst; n < nEnd; n++) {
+      pixelIndexes[n * numPoints + lineIndex] = pixelIndex + n;
+      pixels[n * numPoints + lineIndex] = inputPixels[pixelIndex + n];
+      values[n * numPoints + lineIndex] = keys[pixelIndex + n];
+    }
+  }
+
+  for (int n = 0; n < lines; n++) {
+    if (firstIndexes[n] < numPoints) {
+      sortGatheredLine<PixelT, KeyT, Bits>(
+          inputPixels, outputPixels, numPoints, width, height,
+          firstIndexes[n], endIndexes[n], valueMin, valueMax,
+          values + n * numPoints, pixelIndexes + n * numPoints,
+          buffers.count.data(), buffers.order.data(), pixels + n * numPoints);
+    }
+  }
+  return true;
+}
+
+// Count lines as done, if anyone is following the sort
+static void addLinesDone(SortProgress *progress, long lines) {
+  if (progress != NULL) {
+    progress->linesDone.fetch_add(lines, std::memory_order_relaxed);
+  }
+}
+
+// Private helper to find how many lines can be sorted between releasing the
+// pages of paging, out of lineCount. Each chunk of lines pages in fixedBytes
+// whatever its size, and lineBytes more for each line. The chunk is a multiple
+// of minLines, and all of the lines if paging is NULL
+static int chunkLines(const SortPaging *paging, int lineCount,
+                      size_t fixedBytes, size_t lineBytes, int minLines) {
+  if (paging == NULL) {
+    return lineCount;
+  }
+  size_t lines = 0;
+  if (paging->residentBytes > fixedBytes) {
+    size_t bytes = paging->residentBytes - fixedBytes;
+    lines = bytes / std::max<size_t>(1, lineBytes);
+  }
+  lines = std::min(lines, (size_t)lineCount) / minLines * minLines;
+  return std::max<int>(minLines, lines);
+}
+
+// Private helper to call chunkTask on each chunk of chunkSize lines of
+// [firstL, endL), releasing the pages of paging after each one. Stops early if
+// progress is cancelled
+template <typename ChunkTask>
+static void forEachChunk(int firstL, int endL, int chunkSize,
+                         const SortPaging *paging, SortProgress *progress,
+                         ChunkTask chunkTask) {
+  for (int chunkFirst = firstL; chunkFirst < endL;) {
+    if (progress != NULL && progress->isCancelled()) {
+      return;
+    }
+    int chunkEnd = std::min(endL, chunkFirst + chunkSize);
+    chunkTask(chunkFirst, chunkEnd);
+    if (paging != NULL && paging->releasePages) {
+      paging->releasePages();
+    }
+    chunkFirst = chunkEnd;
+  }
+}
+
+// Private helper to sort the band from bandStart up to bandEnd of a straight
+// line, held step pixels apart in memory. Same as sortBand
+template <typename PixelT, typename KeyT, int Bits>
+static void sortStraightBand(const PixelT *input, PixelT *output,
+                             const KeyT *keys, int step, int bandStart,
+                             int bandEnd, COUNT_T *count, int *order) {
+  int length = bandEnd - bandStart;
+  if (sortBandOrder<KeyT, Bits>(keys + bandStart * step, step, length, order,
+                                count)) {
+    for (int i = 0; i < length; i++) {
+      output[(bandStart + i) * step] = input[(bandStart + order[i]) * step];
+    }
+    return;
+  }
+
+  std::fill(count, count + KEY_MAX(Bits) + 1, 0);
+  for (int i = bandStart; i < bandEnd; i++) {
+    (count[keys[i * step]])++;
+  }
+  for (int i = 1; i <= KEY_MAX(Bits); i++) {
+    (count[i]) += (count[i - 1]);
+  }
+  for (int i = bandStart; i < bandEnd; i++) {
+    int outputIndex = bandStart + --(count[keys[i * step]]);
+    output[outputIndex * step] = input[i * step];
+  }
+}
+
+// Private helper to sort a straight line of length pixels, held step pixels
+// apart in memory and entirely inside the image. Same as sortEachLine
+template <typename PixelT, typename KeyT, int Bits>
+static void sortStraightLine(const PixelT *input, PixelT *output,
+                             const KeyT *keys, int length, int step,
+                             int valueMin, int valueMax, COUNT_T *count,
+                             int *order) {
+  int bandStart = 0;
+  bool wasLastInBand = false;
+  for (int i = 0; i < length; i++) {
+    KeyT value = keys[i * step];
+    if (valueMin <= value && valueMax >= value) {
+      if (!wasLastInBand) {
+        bandStart = i;
+      }
+      wasLastInBand = true;
+    } else {
+      output[i * step] = input[i * step];
+      if (wasLastInBand) {
+        sortStraightBand<PixelT, KeyT, Bits>(input, output, keys, step,
+                                             bandStart, i, count, order);
+      }
+      wasLastInBand = false;
+    }
+  }
+  if (wasLastInBand) {
+    sortStraightBand<PixelT, KeyT, Bits>(input, output, keys, step,
+                                         bandStart, length, count, order);
+  }
+}
+
+// Private helper to sort the rows from firstRow up to endRow, in the direction
+// of step (1 or -1)
+template <typename PixelT, typename KeyT, int Bits>
+static void sortRows(const ImageView &input, const ImageView &output,
+                     int step, int firstRow, int endRow, int valueMin,
+                     int valueMax, const KeyT *keys,
+                     SortWorkspace::Buffers &buffers, SortProgress *progress) {
+  int rowLength = input.rowLength();
+  const PixelT *inputPixels = input.pixelsOf<PixelT>();
+  PixelT *outputPixels = output.pixelsOf<PixelT>();
+  // Sorting in place would overwrite pixels of the row before they are read,
+  // so each row is copied out first
+  bool inPlace = inputPixels == outputPixels;
+  PixelT *rowPixels = buffers.pixelsOf<PixelT>();
+  // Lines start at the end of the row they step away from
+  int start = step > 0 ? 0 : input.width - 1;
+  for (int row = firstRow; row < endRow; row++) {
+    if (progress != NULL && progress->isCancelled()) {
+      return;
+    }
+    int rowFirst = TWOD_TO_1D(0, row, rowLength);
+    int rowStart = TWOD_TO_1D(start, row, rowLength);
+    const PixelT *rowInput = inputPixels + rowStart;
+    if (inPlace) {
+      std::copy(inputPixels + rowFirst, inputPixels + rowFirst + input.width,
+                rowPixels);
+      rowInput = rowPixels + start;
+    }
+    sortStraightLine<PixelT, KeyT, Bits>(
+        rowInput, outputPixels + rowStart, keys + rowStart, input.width, step,
+        valueMin, valueMax, buffers.count.data(), buffers.order.data());
+    addLinesDone(progress, 1);
+  }
+}
+
+// Private helper to sort the columns of strips from firstStrip up to
+// endStrip, in the direction of step (1 or -1). Each strip of columns is
+// copied into rows (in the order the lines step through them), sorted there,
+// and copied back, so the image is only ever read and written a cache line at
+// a time
+template <typename PixelT, typename KeyT, int Bits>
+static void sortColumnStrips(const ImageView &input, const ImageView &output,
+                             int step, int firstStrip, int endStrip,
+                             int valueMin, int valueMax, const KeyT *keys,
+                             SortWorkspace::Buffers &buffers,
+                             SortProgress *progress) {
+  int rowLength = input.rowLength();
+  int height = input.height;
+  const PixelT *inputPixels = input.pixelsOf<PixelT>();
+  PixelT *outputPixels = output.pixelsOf<PixelT>();
+  PixelT *stripInput = buffers.stripInputOf<PixelT>();
+  PixelT *stripOutput = buffers.stripOutputOf<PixelT>();
+  KeyT *stripKeys = buffers.stripKeysOf<KeyT>();
+  for (int strip = firstStrip; strip < endStrip; strip++) {
+    if (progress != NULL && progress->isCancelled()) {
+      return;
+    }
+    int firstColumn = strip * COLUMN_STRIP_WIDTH;
+    int columns = std::min(COLUMN_STRIP_WIDTH, input.width - firstColumn);
+
+    // Copy the columns into rows
+    for (int i = 0; i < height; i++) {
+      int row = step > 0 ? i : height - 1 - i;
+      int pixelIndex = TWOD_TO_1D(firstColumn, row, rowLength);
+      for (int column = 0; column < columns; column++) {
+        stripInput[column * height + i] = inputPixels[pixelIndex + column];
+        stripKeys[column * height + i] = keys[pixelIndex + column];
+      }
+    }
+
+    for (int column = 0; column < columns; column++) {
+      sortStraightLine<PixelT, KeyT, Bits>(
+          stripInput + column * height, stripOutput + column * height,
+          stripKeys + column * height, height, 1, valueMin, valueMax,
+          buffers.count.data(), buffers.order.data());
+    }
+
+    // Copy the sorted rows back into the columns
+    for (int i = 0; i < height; i++) {
+      int row = step > 0 ? i : height - 1 - i;
+      int pixelIndex = TWOD_TO_1D(firstColumn, row, rowLength);
+      for (int column = 0; column < columns; column++) {
+        outputPixels[pixelIndex + column] = stripOutput[column * height + i];
+      }
+    }
+    addLinesDone(progress, columns);
+  }
+}
+
+// Private helper to sort along a line that is a single run, so every line is
+// a whole row or a whole column of the image
+template <typename PixelT, typename KeyT, int Bits>
+static void sortStraightLines(const ImageView &input, const ImageView &output,
+                              const LineCollision::LineRuns &line,
+                              int valueMin, int valueMax, const KeyT *keys,
+                              SortWorkspace &workspace, ThreadPool *pool,
+                              SortProgress *progress,
+                              const SortPaging *paging) {
+  int workerCount = pool == NULL ? 1 : pool->size();
+  int lines = line.majorIsX ? input.height : input.width;
+  if (progress != NULL) {
+    progress->linesTotal = lines;
+  }
+  // Bytes of the input, output and keys of each pixel
+  size_t pointBytes = 2 * sizeof(PixelT) + sizeof(KeyT);
+
+  if (line.majorIsX) {
+    auto rowTask = [&](int firstRow, int endRow, int worker) {
+      sortRows<PixelT, KeyT, Bits>(input, output, line.majorStep, firstRow,
+                                   endRow, valueMin, valueMax, keys,
+                                   workspace.buffers(worker), progress);
+    };
+    // Each row pages in itself, and at most a page more of each plane
+    int chunkSize = chunkLines(paging, lines, 0,
+                               input.width * pointBytes + 3 * PAGE_BYTES, 1);
+    auto chunkTask = [&](int firstRow, int endRow) {
+      if (pool == NULL) {
+        rowTask(firstRow, endRow, 0);
+        return;
+      }
+      int rows = endRow - firstRow;
+      pool->parallelFor(firstRow, endRow,
+                        rows / (workerCount * LINE_BLOCKS_PER_WORKER) + 1,
+                        rowTask);
+    };
+    forEachChunk(0, lines, chunkSize, paging, progress, chunkTask);
+    return;
+  }
+
+  workspace.reserveStrips(workerCount, COLUMN_STRIP_WIDTH * input.height, Bits,
+                          sizeof(PixelT));
+  int strips = (input.width + COLUMN_STRIP_WIDTH - 1) / COLUMN_STRIP_WIDTH;
+  auto stripTask = [&](int firstStrip, int endStrip, int worker) {
+    sortColumnStrips<PixelT, KeyT, Bits>(input, output, line.majorStep,
+                                         firstStrip, endStrip, valueMin,
+                                         valueMax, keys,
+                                         workspace.buffers(worker), progress);
+  };
+  // Every strip touches every row, which pages in at least a page of each
+  // plane however few strips there are
+  int chunkSize = chunkLines(
+      paging, strips, (size_t)input.height * 3 * PAGE_BYTES,
+      (size_t)input.height * COLUMN_STRIP_WIDTH * pointBytes, 1);
+  auto chunkTask = [&](int firstStrip, int endStrip) {
+    if (pool == NULL) {
+      stripTask(firstStrip, endStrip, 0);
+    } else {
+      pool->parallelFor(firstStrip, endStrip, 1, stripTask);
+    }
+  };
+  forEachChunk(0, strips, chunkSize, paging, progress, chunkTask);
+}
+
+// Sort every line whose L coordinate is in [firstL, endL). Lines that miss the
+// image are skipped, and once a line has hit the image the first line to miss
+// it again ends the range, as every line after it also misses.
+template <typename PixelT, typename KeyT, int Bits>
+void sortLineRange(PixelT *&inputPixels, PixelT *&outputPixels,
+                   const LineCollision::LineRuns &line, int width, int height,
+                   int rowLength, int x, int y, bool lIsX, int firstL,
+                   int endL, int valueMin, int valueMax, const KeyT *keys,
+                   SortWorkspace::Buffers &buffers, SortProgress *progress) {
+  if (lIsX) {
+    // Lines next to each other along X share cache lines, walk them together
+    bool hitImage = false; // Has a bundle hit the image yet?
+    int firstX = firstL;
+    for (; firstX < endL; firstX += LINE_BUNDLE_SIZE) {
+      if (progress != NULL && progress->isCancelled()) {
+        return;
+      }
+      int lines = std::min(LINE_BUNDLE_SIZE, endL - firstX);
+      bool hit = sortLineBundle<PixelT, KeyT, Bits>(
+          inputPixels, outputPixels, line, width, height, rowLength, firstX,
+          lines, y, valueMin, valueMax, keys, buffers);
+      addLinesDone(progress, lines);
+      if (hit) {
+        hitImage = true;
+      } else if (hitImage) {
+        firstX += lines;
+        break; // Every line after this one also misses
+      }
+    }
+    // The rest of the lines all miss the image
+    addLinesDone(progress, std::max(0, endL - firstX));
+    return;
+  }
+
+  int *l = lIsX ? &x : &y; // The index of the current line along L
+
+  bool endedInBounds = false; // Did the last band end in bounds?
+  // Go through each empty line (go until we hit the image)
+  for (*l = firstL; *l < endL && !endedInBounds; (*l)++) {
+    if (progress != NULL && progress->isCancelled()) {
+      return;
+    }
+    endedInBounds = sortEachLine<PixelT, KeyT, Bits>(
+        inputPixels, outputPixels, line, width, height, rowLength, x, y,
+        valueMin, valueMax, keys, buffers);
+    addLinesDone(progress, 1);
+  }
+
+  // For each line along l, increase it by 1
+  for (; *l < endL && endedInBounds; (*l)++) {
+    if (progress != NULL && progress->isCancelled()) {
+      return;
+    }
+    endedInBounds = sortEachLine<PixelT, KeyT, Bits>(
+        inputPixels, outputPixels, line, width, height, rowLength, x, y,
+        valueMin, valueMax, keys, buffers);
+    addLinesDone(progress, 1);
+  }
+  // The rest of the lines all miss the image
+  addLinesDone(progress, endL - *l);
+}
+
+// Private helper for sort, with pixels of type PixelT and keys of Bits bits
+template <typename PixelT, typename KeyT, int Bits>
+static void sortPixels(const ImageView &input, const ImageView &output,
+                       const LineCollision::LineRuns &line, int startX,
                        int startY, int endX, int endY, double valueMin,
-                       double valueMax, ColorConverter *converter,
-                       SDL_PixelFormat *format) {
+                       double valueMax, const KeyT *keys,
+                       SortWorkspace &workspace, ThreadPool *pool,
+                       SortProgress *progress, const SortPaging *paging) {
+  PixelT *inputPixels = input.pixelsOf<PixelT>();
+  PixelT *outputPixels = output.pixelsOf<PixelT>();
+  int width = input.width;
+  int height = input.height;
+  int rowLength = input.rowLength();
+
+  int intValueMin = valueMin * KEY_MAX(Bits);
+  int intValueMax = valueMax * KEY_MAX(Bits);
+
+  // Only allocates if this image has longer lines than the last one sorted
+  workspace.reserve(pool == NULL ? 1 : pool->size(), line.numPoints,
+                    LINE_BUNDLE_SIZE, Bits, sizeof(PixelT));
+
+  // A line with one run is straight, and every line is a row or a column
+  if (line.numRuns() == 1) {
+    sortStraightLines<PixelT, KeyT, Bits>(input, output, line, intValueMin,
+                                          intValueMax, keys, workspace, pool,
+                                          progress, paging);
+    return;
+  }
+
   int deltaX = endX - startX;
   int deltaY = endY - startY;
 
@@ -182,17 +856,14 @@ void PixelSorter::sort(PixelSorter_Pixel_t *&inputPixels,
   int maxL = 0; // The maximum value of L to sort with
   // Use pointers to save on lines of code
   int *deltaS = NULL; // The min of deltaX deltaY
-  // The index of the current line along the L dimension
-  int *l = NULL;
+  bool lIsX = std::abs(deltaX) <= std::abs(deltaY);
 
-  if (std::abs(deltaX) <= std::abs(deltaY)) { // X changes less or same as Y
-    l = &x;
+  if (lIsX) { // X changes less or same as Y
     maxL = width;
     deltaS = &deltaY;
     // Offset starting y to the appropriate side, given the lines direction
     y = (deltaY >= 0) ? 0 : height - 1;
   } else { // Y changes less than X
-    l = &y;
     maxL = height;
     deltaS = &deltaX;
     // Offset starting x to the appropriate side, given the lines direction
@@ -204,20 +875,190 @@ void PixelSorter::sort(PixelSorter_Pixel_t *&inputPixels,
   minL -= offset;
   maxL += offset;
 
-  bool endedInBounds = false; // Did the last band end in bounds?
-  // Go through each empty line (go until we hit the image)
-  for (*l = minL; *l < maxL && !endedInBounds; (*l)++) {
-    endedInBounds =
-        sortEachLine(inputPixels, outputPixels, points, numPoints, width,
-                     height, deltaX, deltaY, x, y, valueMin * PRECISION,
-                     valueMax * PRECISION, converter, format);
+  if (progress != NULL) {
+    progress->linesTotal = maxL - minL;
   }
 
-  // For each line along l, increase it by 1
-  for (; *l < maxL && endedInBounds; (*l)++) {
-    endedInBounds =
-        sortEachLine(inputPixels, outputPixels, points, numPoints, width,
-                     height, deltaX, deltaY, x, y, valueMin * PRECISION,
-                     valueMax * PRECISION, converter, format);
+  auto chunkTask = [&](int chunkFirst, int chunkEnd) {
+    if (pool == NULL) {
+      sortLineRange<PixelT, KeyT, Bits>(
+          inputPixels, outputPixels, line, width, height, rowLength, x, y,
+          lIsX, chunkFirst, chunkEnd, intValueMin, intValueMax, keys,
+          workspace.buffers(0), progress);
+      return;
+    }
+    /*
+     * Every pixel is on exactly one line, so lines never write to the same
+     * output pixel and can be sorted in any order. Hand out small blocks of
+     * lines so that workers who get short lines (near the corners) take
+     * more.
+     */
+    int blockSize = (chunkEnd - chunkFirst) /
+                        (pool->size() * LINE_BLOCKS_PER_WORKER) +
+                    1;
+    pool->parallelFor(chunkFirst, chunkEnd, blockSize,
+                      [&](int firstL, int endL, int worker) {
+                        sortLineRange<PixelT, KeyT, Bits>(
+                            inputPixels, outputPixels, line, width, height,
+                            rowLength, x, y, lIsX, firstL, endL, intValueMin,
+                            intValueMax, keys, workspace.buffers(worker),
+                            progress);
+                      });
+  };
+  // A chunk of lines crosses every row, touching at least a page of each
+  // plane in each. Shallow lines touch a whole run of each row they cross
+  size_t pointBytes = 2 * sizeof(PixelT) + sizeof(KeyT);
+  int pointsPerRow =
+      lIsX ? 1 : (line.numPoints + line.numRuns() - 1) / line.numRuns();
+  int chunkSize = chunkLines(paging, maxL - minL,
+                             (size_t)height * 3 * PAGE_BYTES,
+                             (size_t)height * pointsPerRow * pointBytes,
+                             LINE_BUNDLE_SIZE);
+  forEachChunk(minL, maxL, chunkSize, paging, progress, chunkTask);
+}
+
+// Private helper for sort, with keys of Bits bits. Picks the pixel type from
+// the format of the images once, so no pixel has to check it
+template <typename KeyT, int Bits>
+static void sortKeys(const ImageView &input, const ImageView &output,
+                     const LineCollision::LineRuns &line, int startX,
+                     int startY, int endX, int endY, double valueMin,
+                     double valueMax, const KeyT *keys,
+                     SortWorkspace &workspace, ThreadPool *pool,
+                     SortProgress *progress, const SortPaging *paging) {
+  switch (input.format) {
+  case PIXELFORMAT_RGBA64:
+    sortPixels<PixelRGBA16, KeyT, Bits>(input, output, line, startX, startY,
+                                        endX, endY, valueMin, valueMax, keys,
+                                        workspace, pool, progress, paging);
+    break;
+  case PIXELFORMAT_RGBA128_FLOAT:
+    sortPixels<PixelRGBA32F, KeyT, Bits>(input, output, line, startX, startY,
+                                         endX, endY, valueMin, valueMax, keys,
+                                         workspace, pool, progress,
+                                         paging);
+    break;
+  default:
+    // The 32 bit formats only differ in what the sort never looks at
+    sortPixels<PixelSorter_Pixel_t, KeyT, Bits>(
+        input, output, line, startX, startY, endX, endY, valueMin, valueMax,
+        keys, workspace, pool, progress, paging);
+    break;
   }
 }
+
+bool PixelSorter::keyBitsSupported(int keyBits) {
+  return keyBits == 8 || keyBits == 12 || keyBits == 16;
+}
+
+void PixelSorter::sort(const ImageView &input, const ImageView &output,
+                       const LineCollision::LineRuns &line, int startX,
+                       int startY, int endX, int endY, double valueMin,
+                       double valueMax, const PixelSorter_value_t *keys,
+                       SortWorkspace &workspace, ThreadPool *pool,
+                       SortProgress *progress, const SortPaging *paging) {
+  sortKeys<PixelSorter_value_t, 8>(input, output, line, startX, startY, endX,
+                                   endY, valueMin, valueMax, keys, workspace,
+                                   pool, progress, paging);
+}
+
+void PixelSorter::sort(const ImageView &input, const ImageView &output,
+                       const LineCollision::LineRuns &line, int startX,
+                       int startY, int endX, int endY, double valueMin,
+                       double valueMax, const PixelSorter_wideValue_t *keys,
+                       int keyBits, SortWorkspace &workspace,
+                       ThreadPool *pool, SortProgress *progress,
+                       const SortPaging *paging) {
+  if (keyBits == 12) {
+    sortKeys<PixelSorter_wideValue_t, 12>(input, output, line, startX, startY,
+                                          endX, endY, valueMin, valueMax, keys,
+                                          workspace, pool, progress, paging);
+  } else {
+    sortKeys<PixelSorter_wideValue_t, 16>(input, output, line, startX, startY,
+                                          endX, endY, valueMin, valueMax, keys,
+                                          workspace, pool, progress, paging);
+  }
+}
+
+// Private helper for sortImage, gets the line at angle and the corner of the
+// image its lines start from. Returns NULL if the images differ in size
+static const SortWorkspace::Line *
+lineForImage(const ImageView &input, const ImageView &output, double angle,
+             SortWorkspace &workspace, int &startX, int &startY, int &endX,
+             int &endY) {
+  if (input.width != output.width || input.height != output.height ||
+      input.stride != output.stride) {
+    fprintf(stderr, "Input and output images must be the same size\n");
+    return NULL;
+  }
+  if (pixelFormatBytes(input.format) != pixelFormatBytes(output.format)) {
+    fprintf(stderr, "Input and output images must have the same pixels\n");
+    return NULL;
+  }
+  int width = input.width;
+  int height = input.height;
+
+  // Get the line, only generated when the angle or size has changed
+  const SortWorkspace::Line &line = workspace.line(angle, width, height);
+  angle = line.generatedAngle;
+  const BresenhamsArguments &bresenhamsArgs = line.args;
+
+  // Shift to specific corner for each quadrant
+  if (angle >= 0 && angle < 90) { // +x +y quadrant
+    startX = 0;
+    startY = 0;
+  } else if (angle >= 90 && angle < 180) { // -x +y quadrant
+    startX = width - 1;
+    startY = 0;
+  } else if (angle >= 180 && angle < 270) { // -x -y quadrant
+    startX = width - 1;
+    startY = height - 1;
+  } else { // +x -y quadrant
+    startX = 0;
+    startY = height - 1;
+  }
+  // Properly set endX and endY
+  endX = bresenhamsArgs.deltaX + startX;
+  endY = bresenhamsArgs.deltaY + startY;
+  return &line;
+}
+
+bool PixelSorter::sortImage(const ImageView &input, const ImageView &output,
+                            double angle, double valueMin, double valueMax,
+                            const PixelSorter_value_t *keys,
+                            SortWorkspace &workspace, ThreadPool *pool,
+                            SortProgress *progress,
+                            const SortPaging *paging) {
+  // Start and end coordinates for making multiple lines
+  int startX, startY, endX, endY;
+  const SortWorkspace::Line *line = lineForImage(
+      input, output, angle, workspace, startX, startY, endX, endY);
+  if (line == NULL) {
+    return false;
+  }
+  sort(input, output, line->runs, startX, startY, endX, endY, valueMin,
+       valueMax, keys, workspace, pool, progress, paging);
+  return true;
+}
+
+bool PixelSorter::sortImage(const ImageView &input, const ImageView &output,
+                            double angle, double valueMin, double valueMax,
+                            const PixelSorter_wideValue_t *keys, int keyBits,
+                            SortWorkspace &workspace, ThreadPool *pool,
+                            SortProgress *progress,
+                            const SortPaging *paging) {
+  if (!keyBitsSupported(keyBits) || keyBits == 8) {
+    fprintf(stderr, "Can not sort by keys of %d bits\n", keyBits);
+    return false;
+  }
+  // Start and end coordinates for making multiple lines
+  int startX, startY, endX, endY;
+  const SortWorkspace::Line *line = lineForImage(
+      input, output, angle, workspace, startX, startY, endX, endY);
+  if (line == NULL) {
+    return false;
+  }
+  sort(input, output, line->runs, startX, startY, endX, endY, valueMin,
+       valueMax, keys, keyBits, workspace, pool, progress, paging);
+  return true;
+}
@@ -1,25 +1,116 @@
 #ifndef PIXELSORTER_HPP_
 #define PIXELSORTER_HPP_
 
-#include "ColorConversion.hpp"
-#include "SDL_pixels.h"
+#include "ImageView.hpp"
+#include "LineCollision.hpp"
+#include "ThreadPool.hpp"
+#include <atomic>
+#include <cstddef>
 #include <cstdint>
+#include <functional>
 
-
-typedef std::pair<int, int> point_ints;
-// By default, assumes format
+// A pixel of the 32 bit formats. Images of PixelRGBA16 and PixelRGBA32F (see
+// ImageView.hpp) are sorted by the same code, made for each type
 typedef uint32_t PixelSorter_Pixel_t;
 typedef uint8_t PixelSorter_value_t;
 #define PIXELSORTER_VALUE_T_MAX UINT8_MAX
 #define PRECISION UINT8_MAX
+// Keys of more than 8 bits, for smoother gradients (see KeyPlane::updateWide)
+typedef uint16_t PixelSorter_wideValue_t;
+// Keys with up to this many bits are counting sorted, wider ones radix sorted
+#define PIXELSORTER_COUNTING_BITS 12
 typedef long Count_t;
 
+class SortWorkspace;
+
+// Lets other threads follow how far a sort has got, and stop it early. Lines
+// are counted along L, including the lines that miss the image
+struct SortProgress {
+  std::atomic<long> linesDone{0};
+  std::atomic<long> linesTotal{0}; // 0 until the lines are generated
+  std::atomic<bool> cancelled{false};
+
+  // Fraction of the lines sorted, 0 to 1
+  float fraction() const {
+    long total = linesTotal.load(std::memory_order_relaxed);
+    long done = linesDone.load(std::memory_order_relaxed);
+    return total == 0 ? 0.0f : (float)done / total;
+  }
+  bool isCancelled() const {
+    return cancelled.load(std::memory_order_relaxed);
+  }
+};
+
+// Bounds how much of an image is in memory at once while it is converted and
+// sorted, for images in memory mapped files that are larger than memory. The
+// work is split into chunks whose pages should fit in residentBytes, and
+// releasePages is called after each one, to drop the pages of the images
+// (and keys) it used. Chunks are never less than a few lines, so a budget that
+// is too small for the image is overrun instead of failing
+struct SortPaging {
+  size_t residentBytes = 0;
+  std::function<void()> releasePages;
+};
+
 namespace PixelSorter {
-void sort(PixelSorter_Pixel_t *&inputPixels,
-          PixelSorter_Pixel_t *&outputPixels, point_ints *points,
-          int numPoints, int width, int height, int startX, int startY,
+// Sort a band (span) of pixels of a line by the Bits bit values, from
+// bandStartIndex up to bandEndIndex. values and pixelIndexes are indexed by
+// lineIndex, count must be able to hold
+// 1 << min(Bits, PIXELSORTER_COUNTING_BITS) counts and order twice as many
+// ints as there are pixels in the band. inputPixels and outputPixels must not
+// be the same pixels. Only instantiated for 8 bit
+// PixelSorter_value_t, and 12 or 16 bit PixelSorter_wideValue_t, of
+// PixelSorter_Pixel_t, PixelRGBA16 and PixelRGBA32F pixels
+template <typename PixelT, typename KeyT, int Bits = 8>
+void sortBand(PixelT *&inputPixels, PixelT *&outputPixels, KeyT *values,
+              int *pixelIndexes, Count_t *count, int *order, int numPoints,
+              int width, int height, int bandStartIndex, int bandEndIndex);
+
+// True if sorts can be keyed by keys of keyBits bits: 8, 12 or 16
+bool keyBitsSupported(int keyBits);
+
+// Sort the pixels of input along lines parallel to line into output, by the
+// values in keys (see KeyPlane). Both images must be the same size, and have
+// the same stride and type of pixel. Pixels are moved untouched, so deeper
+// formats keep every bit. workspace holds the scratch memory, and can be reused
+// between sorts. If pool is not NULL, the lines are split across its workers.
+// If progress is not NULL the sort reports to it, and stops soon after it is
+// cancelled, leaving output partly sorted. If paging is not NULL, the lines
+// are sorted in chunks that keep to its budget.
+// output may be input itself, to sort it in place without a second image. The
+// keys then no longer match the image, so its KeyPlane must be invalidated
+void sort(const ImageView &input, const ImageView &output,
+          const LineCollision::LineRuns &line, int startX, int startY,
           int endX, int endY, double valueMin, double valueMax,
-          ColorConverter *converter, SDL_PixelFormat *format);
-}
+          const PixelSorter_value_t *keys, SortWorkspace &workspace,
+          ThreadPool *pool = NULL, SortProgress *progress = NULL,
+          const SortPaging *paging = NULL);
+// The same, by wide keys that each have keyBits bits (12 or 16)
+void sort(const ImageView &input, const ImageView &output,
+          const LineCollision::LineRuns &line, int startX, int startY,
+          int endX, int endY, double valueMin, double valueMax,
+          const PixelSorter_wideValue_t *keys, int keyBits,
+          SortWorkspace &workspace, ThreadPool *pool = NULL,
+          SortProgress *progress = NULL, const SortPaging *paging = NULL);
+
+// Sort the pixels of input along lines at angle (in degrees, 0 to 360) into
+// output. Only pixels with values between valueMin and valueMax (0 to 1) are
+// sorted. Generates the lines, then calls sort, so input and output may be
+// the same image. Returns false if the images differ in size or the lines
+// could not be generated
+bool sortImage(const ImageView &input, const ImageView &output, double angle,
+               double valueMin, double valueMax,
+               const PixelSorter_value_t *keys, SortWorkspace &workspace,
+               ThreadPool *pool = NULL, SortProgress *progress = NULL,
+               const SortPaging *paging = NULL);
+// The same, by wide keys that each have keyBits bits (12 or 16). Also returns
+// false if keyBits is not supported
+bool sortImage(const ImageView &input, const ImageView &output, double angle,
+               double valueMin, double valueMax,
+               const PixelSorter_wideValue_t *keys, int keyBits,
+               SortWorkspace &workspace, ThreadPool *pool = NULL,
+               SortProgress *progress = NULL,
+               const SortPaging *paging = NULL);
+} // namespace PixelSorter
 
 #endif // PIXELSORTER_HPP_
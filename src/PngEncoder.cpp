@@ -0,0 +1,340 @@
+#include "PngEncoder.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <zlib.h>
+
+// Uncompressed bytes in each piece deflated on its own. Every piece filters
+// the window of rows before it again, so pieces are kept large
+#define PNG_PIECE_BYTES (1 << 20)
+// How far back deflate looks, so how much of the rows before a piece is
+// worth priming it with
+#define PNG_WINDOW_BYTES 32768
+// Pieces deflated at once for each worker, before being written out in order
+#define PNG_PIECES_PER_WORKER 2
+// Most bytes in a single png chunk, well under the 2GiB it allows
+#define PNG_CHUNK_BYTES (1 << 30)
+
+static const uint8_t PNG_SIGNATURE[8] = {137, 80, 78, 71, 13, 10, 26, 10};
+
+// Filters a png row can be stored with, each predicting a byte from those
+// before and above it
+enum PngFilter {
+  PNG_FILTER_NONE,
+  PNG_FILTER_SUB,
+  PNG_FILTER_UP,
+  PNG_FILTER_AVERAGE,
+  PNG_FILTER_PAETH,
+  PNG_FILTER_COUNT
+};
+
+// One piece of the rows, deflated
+struct PngPiece {
+  std::vector<uint8_t> data;
+  uLong adler;   // Adler-32 of the filtered rows
+  size_t length; // Bytes of filtered rows
+  bool deflated;
+};
+
+// Private helper to store value at bytes, most significant byte first
+static void putBigEndian(uint8_t *bytes, uint32_t value) {
+  bytes[0] = value >> 24;
+  bytes[1] = value >> 16;
+  bytes[2] = value >> 8;
+  bytes[3] = value;
+}
+
+// Private helper to write row y of image to packed as a png stores it: RGBA,
+// with 16 bit channels most significant byte first
+static void packRow(const ImageView &image, int y, uint8_t *packed) {
+  const uint8_t *row = (const uint8_t *)image.pixels + (size_t)y * image.stride;
+  if (image.format == PIXELFORMAT_RGBA64) {
+    const PixelRGBA16 *pixels = (const PixelRGBA16 *)row;
+    for (int x = 0; x < image.width; x++) {
+      const uint16_t channels[4] = {pixels[x].r, pixels[x].g, pixels[x].b,
+                                    pixels[x].a};
+      for (uint16_t channel : channels) {
+        *packed++ = channel >> 8;
+        *packed++ = channel;
+      }
+    }
+    return;
+  }
+  PixelFormatShifts shifts = pixelFormatShifts(image.format);
+  const uint32_t *pixels = (const uint32_t *)row;
+  for (int x = 0; x < image.width; x++) {
+    *packed++ = pixels[x] >> shifts.r;
+    *packed++ = pixels[x] >> shifts.g;
+    *packed++ = pixels[x] >> shifts.b;
+    *packed++ = pixels[x] >> shifts.a;
+  }
+}
+
+// Private helper to predict a byte from the one to its left, the one above
+// it, and the one above that on the left
+static inline int paethPredictor(int left, int up, int upLeft) {
+  int estimate = left + up - upLeft;
+  int toLeft = abs(estimate - left);
+  int toUp = abs(estimate - up);
+  int toUpLeft = abs(estimate - upLeft);
+  if (toLeft <= toUp && toLeft <= toUpLeft) {
+    return left;
+  }
+  return toUp <= toUpLeft ? up : upLeft;
+}
+
+// Private helper to filter length bytes of row, with pixels of pixelBytes
+// and above as the row before it, into filtered. Returns the sum of the
+// filtered bytes taken as signed, which is smaller the better they compress
+static unsigned long filterRow(PngFilter filter, const uint8_t *row,
+                               const uint8_t *above, size_t length,
+                               int pixelBytes, uint8_t *filtered) {
+  // The bytes of the pixel to the left, which the first pixel does not have
+  const uint8_t *left = row - pixelBytes;
+  const uint8_t *upLeft = above - pixelBytes;
+  switch (filter) {
+  case PNG_FILTER_SUB:
+    memcpy(filtered, row, pixelBytes);
+    for (size_t i = pixelBytes; i < length; i++) {
+      filtered[i] = row[i] - left[i];
+    }
+    break;
+  case PNG_FILTER_UP:
+    for (size_t i = 0; i < length; i++) {
+      filtered[i] = row[i] - above[i];
+    }
+    break;
+  case PNG_FILTER_AVERAGE:
+    for (int i = 0; i < pixelBytes; i++) {
+      filtered[i] = row[i] - (above[i] >> 1);
+    }
+    for (size_t i = pixelBytes; i < length; i++) {
+      filtered[i] = row[i] - ((left[i] + above[i]) >> 1);
+    }
+    break;
+  case PNG_FILTER_PAETH:
+    // With nothing to the left, Paeth predicts the byte above
+    for (int i = 0; i < pixelBytes; i++) {
+      filtered[i] = row[i] - above[i];
+    }
+    for (size_t i = pixelBytes; i < length; i++) {
+      filtered[i] = row[i] - paethPredictor(left[i], above[i], upLeft[i]);
+    }
+    break;
+  default:
+    memcpy(filtered, row, length);
+    break;
+  }
+  unsigned long sum = 0;
+  for (size_t i = 0; i < length; i++) {
+    sum += abs((int8_t)filtered[i]);
+  }
+  return sum;
+}
+
+// Private helper to filter row with each filter, as libpng does by default,
+// and keep the one that compresses best. out gets the filter, then the
+// filtered row. candidate is scratch space of length bytes
+static void filterRowAdaptive(const uint8_t *row, const uint8_t *above,
+                              size_t length, int pixelBytes, uint8_t *out,
+                              std::vector<uint8_t> &candidate) {
+  candidate.resize(length);
+  out[0] = PNG_FILTER_NONE;
+  unsigned long best =
+      filterRow(PNG_FILTER_NONE, row, above, length, pixelBytes, out + 1);
+  for (int filter = PNG_FILTER_SUB; filter < PNG_FILTER_COUNT; filter++) {
+    unsigned long sum = filterRow((PngFilter)filter, row, above, length,
+                                  pixelBytes, candidate.data());
+    if (sum < best) {
+      best = sum;
+      out[0] = filter;
+      memcpy(out + 1, candidate.data(), length);
+    }
+  }
+}
+
+// Private helper to filter and deflate rows [firstRow, endRow) of image into
+// piece, as raw deflate data that ends on a byte boundary so it can be joined
+// to the pieces after it, or that ends the stream if last. Returns false on
+// failure
+static bool deflatePiece(const ImageView &image, int firstRow, int endRow,
+                         int level, bool last, PngPiece &piece) {
+  int pixelBytes = image.format == PIXELFORMAT_RGBA64 ? 8 : 4;
+  size_t rowBytes = (size_t)image.width * pixelBytes;
+  size_t filteredBytes = rowBytes + 1;
+  // Rows before the piece filled into deflate's window, so that it finds the
+  // same matches it would in a single stream
+  int primeRows = std::min<size_t>(
+      firstRow, (PNG_WINDOW_BYTES + filteredBytes - 1) / filteredBytes);
+  int primeRow = firstRow - primeRows;
+
+  std::vector<uint8_t> filtered((size_t)(endRow - primeRow) * filteredBytes);
+  std::vector<uint8_t> above(rowBytes, 0);
+  std::vector<uint8_t> row(rowBytes);
+  std::vector<uint8_t> candidate;
+  if (primeRow > 0) {
+    packRow(image, primeRow - 1, above.data());
+  }
+  for (int y = primeRow; y < endRow; y++) {
+    packRow(image, y, row.data());
+    filterRowAdaptive(row.data(), above.data(), rowBytes, pixelBytes,
+                      filtered.data() + (size_t)(y - primeRow) * filteredBytes,
+                      candidate);
+    std::swap(row, above);
+  }
+
+  z_stream stream = {};
+  // Negative window bits make raw deflate data, without zlib's header
+  if (deflateInit2(&stream, level, Z_DEFLATED, -MAX_WBITS, 8, Z_FILTERED) !=
+      Z_OK) {
+    return false;
+  }
+  size_t primeBytes = (size_t)primeRows * filteredBytes;
+  size_t dictionaryBytes = std::min<size_t>(primeBytes, PNG_WINDOW_BYTES);
+  if (dictionaryBytes > 0) {
+    deflateSetDictionary(&stream,
+                         filtered.data() + primeBytes - dictionaryBytes,
+                         dictionaryBytes);
+  }
+  piece.length = filtered.size() - primeBytes;
+  piece.adler = adler32(adler32(0, NULL, 0), filtered.data() + primeBytes,
+                        piece.length);
+  stream.next_in = filtered.data() + primeBytes;
+  stream.avail_in = piece.length;
+
+  // A sync flush ends the data with an empty stored block, a few bytes past
+  // what deflateBound allows for
+  piece.data.resize(deflateBound(&stream, piece.length) + 16);
+  int flush = last ? Z_FINISH : Z_SYNC_FLUSH;
+  size_t written = 0;
+  bool done = false;
+  while (!done) {
+    if (written == piece.data.size()) {
+      piece.data.resize(piece.data.size() * 2);
+    }
+    stream.next_out = piece.data.data() + written;
+    stream.avail_out = piece.data.size() - written;
+    int status = deflate(&stream, flush);
+    written = piece.data.size() - stream.avail_out;
+    if (status == Z_STREAM_ERROR) {
+      break;
+    }
+    done = last ? status == Z_STREAM_END : stream.avail_out != 0;
+  }
+  deflateEnd(&stream);
+  piece.data.resize(written);
+  return done;
+}
+
+// Private helper to write a png chunk of type, holding size bytes of data.
+// Returns false on failure
+static bool writeChunk(FILE *file, const char *type, const uint8_t *data,
+                       size_t size) {
+  uint8_t header[8];
+  putBigEndian(header, size);
+  memcpy(header + 4, type, 4);
+  uLong crc = crc32(crc32(0, NULL, 0), header + 4, 4);
+  if (size > 0) {
+    crc = crc32(crc, data, size);
+  }
+  uint8_t footer[4];
+  putBigEndian(footer, crc);
+  return fwrite(header, 1, sizeof(header), file) == sizeof(header) &&
+         fwrite(data, 1, size, file) == size &&
+         fwrite(footer, 1, sizeof(footer), file) == sizeof(footer);
+}
+
+bool savePng(const std::string &path, const ImageView &image, int level,
+             ThreadPool *pool) {
+  if (image.format == PIXELFORMAT_RGBA128_FLOAT) {
+    fprintf(stderr, "Can not save floating point images as pngs\n");
+    return false;
+  }
+  if (image.width < 1 || image.height < 1) {
+    fprintf(stderr, "Can not save an empty image as a png\n");
+    return false;
+  }
+  level = std::clamp(level, PNG_MIN_COMPRESSION, PNG_MAX_COMPRESSION);
+  bool deep = image.format == PIXELFORMAT_RGBA64;
+  size_t filteredBytes = (size_t)image.width * (deep ? 8 : 4) + 1;
+  int pieceRows = std::max<size_t>(1, PNG_PIECE_BYTES / filteredBytes);
+  int pieceCount = (image.height + pieceRows - 1) / pieceRows;
+
+  FILE *file = fopen(path.c_str(), "wb");
+  if (file == NULL) {
+    fprintf(stderr, "Could not open %s\n", path.c_str());
+    return false;
+  }
+  uint8_t header[13];
+  putBigEndian(header, image.width);
+  putBigEndian(header + 4, image.height);
+  header[8] = deep ? 16 : 8;
+  header[9] = 6;  // RGBA
+  header[10] = 0; // Deflate
+  header[11] = 0; // Adaptive filtering
+  header[12] = 0; // Not interlaced
+  bool saved = fwrite(PNG_SIGNATURE, 1, sizeof(PNG_SIGNATURE), file) ==
+                   sizeof(PNG_SIGNATURE) &&
+               writeChunk(file, "IHDR", header, sizeof(header));
+
+  // The pieces are joined into one zlib stream, which starts with a header
+  // saying how hard it was compressed (as zlib would write it)...
+  uint8_t zlibHeader[2] = {0x78, 0};
+  int compressionFlags = level < 2 ? 0 : level < 6 ? 1 : level == 6 ? 2 : 3;
+  zlibHeader[1] = compressionFlags << 6;
+  zlibHeader[1] += 31 - (zlibHeader[0] * 256 + zlibHeader[1]) % 31;
+  // ...and ends with the Adler-32 of every piece
+  uLong adler = adler32(0, NULL, 0);
+
+  int batchPieces = (pool == NULL ? 1 : pool->size()) * PNG_PIECES_PER_WORKER;
+  std::vector<PngPiece> pieces(std::min(batchPieces, pieceCount));
+  for (int firstPiece = 0; saved && firstPiece < pieceCount;
+       firstPiece += batchPieces) {
+    int endPiece = std::min(firstPiece + batchPieces, pieceCount);
+    auto deflatePieces = [&](int first, int end, int worker) {
+      for (int p = first; p < end; p++) {
+        int firstRow = p * pieceRows;
+        pieces[p - firstPiece].deflated =
+            deflatePiece(image, firstRow,
+                         std::min(firstRow + pieceRows, image.height), level,
+                         p == pieceCount - 1, pieces[p - firstPiece]);
+      }
+    };
+    if (pool == NULL) {
+      deflatePieces(firstPiece, endPiece, 0);
+    } else {
+      pool->parallelFor(firstPiece, endPiece, 1, deflatePieces);
+    }
+
+    for (int p = firstPiece; saved && p < endPiece; p++) {
+      PngPiece &piece = pieces[p - firstPiece];
+      saved = piece.deflated;
+      adler = adler32_combine(adler, piece.adler, piece.length);
+      if (p == 0) {
+        piece.data.insert(piece.data.begin(), zlibHeader,
+                          zlibHeader + sizeof(zlibHeader));
+      }
+      if (p == pieceCount - 1) {
+        uint8_t footer[4];
+        putBigEndian(footer, adler);
+        piece.data.insert(piece.data.end(), footer, footer + sizeof(footer));
+      }
+      for (size_t offset = 0; saved && offset < piece.data.size();
+           offset += PNG_CHUNK_BYTES) {
+        saved = writeChunk(
+            file, "IDAT", piece.data.data() + offset,
+            std::min<size_t>(PNG_CHUNK_BYTES, piece.data.size() - offset));
+      }
+    }
+  }
+  saved = saved && writeChunk(file, "IEND", NULL, 0);
+  // Data may still be buffered, only closing shows if it could be written
+  saved = fclose(file) == 0 && saved;
+  if (!saved) {
+    fprintf(stderr, "Could not save %s\n", path.c_str());
+  }
+  return saved;
+}
@@ -0,0 +1,29 @@
+/*
+ * Writes pngs with every core. Deflate only looks back 32KiB, so the rows of
+ * an image are cut into large pieces that are filtered and deflated on their
+ * own threads, each primed with the rows just before it, and joined into a
+ * single zlib stream (as pigz does). Only needs zlib, not SDL or libpng.
+ */
+
+#ifndef PNGENCODER_HPP_
+#define PNGENCODER_HPP_
+
+#include "ImageView.hpp"
+#include "ThreadPool.hpp"
+#include <string>
+
+// zlib compression levels: 0 stores the rows as they are, 1 is fastest and 9
+// smallest
+#define PNG_MIN_COMPRESSION 0
+#define PNG_MAX_COMPRESSION 9
+#define PNG_DEFAULT_COMPRESSION 6
+
+// Write image to path as a png, with 16 bits per channel if image is in
+// PIXELFORMAT_RGBA64, otherwise 8. Floating point images can not be saved.
+// level is the compression level, from PNG_MIN_COMPRESSION to
+// PNG_MAX_COMPRESSION. The rows are compressed on the workers of pool, or on
+// this thread if it is NULL. Returns false on failure
+bool savePng(const std::string &path, const ImageView &image,
+             int level = PNG_DEFAULT_COMPRESSION, ThreadPool *pool = NULL);
+
+#endif // PNGENCODER_HPP_
@@ -0,0 +1,94 @@
+#include "Quantizers.hpp"
+#include "ColorTable.hpp"
+#include "global.hpp"
+
+// The options that repersent the pixel quantizers.
+const QuantizerOptionItem quantizer_options[] = {
+    /*
+     * Organized by color spaces in this order:
+     * - RGB
+     * - HSV
+     * - HSL
+     * - Misc.
+     */
+    QuantizerOptionItem(&ColorConversion::red, &ColorConversion::Integer::red,
+                        "red", "Red", "The R in RGB of the pixel"),
+    QuantizerOptionItem(&ColorConversion::green,
+                        &ColorConversion::Integer::green, "green", "Green",
+                        "The G in RGB of the pixel"),
+    QuantizerOptionItem(&ColorConversion::blue,
+                        &ColorConversion::Integer::blue, "blue", "Blue",
+                        "The B in RGB of the pixel"),
+    QuantizerOptionItem(&ColorConversion::hue, NULL, "hue", "Hue",
+                        "The color shade of a pixel.\nThe H in HSV and HSL"),
+    QuantizerOptionItem(
+        &ColorConversion::saturation, NULL, "saturation", "Saturation (HSV)",
+        "How far from pure black a color appears to be.\nCalculated with the "
+        "HSV color space, it is subtly different from the HSL Saturation.\nThe "
+        "S in HSV"),
+    QuantizerOptionItem(
+        &ColorConversion::value, &ColorConversion::Integer::maximum, "value",
+        "Value", "The maximum of the RGB values of the pixel.\nThe V in HSV."),
+    QuantizerOptionItem(
+        &ColorConversion::saturation_HSL, NULL, "saturation_hsl",
+        "Saturation (HSL)",
+        "How far from pure black a color appears to be.\nCalculated with the "
+        "HSL color space, it is subtly different from the HSV Saturation.\n"
+        "The S in HSL."),
+    QuantizerOptionItem(&ColorConversion::lightness, NULL, "lightness",
+                        "Lightness",
+                        "How pale a color appears to be.\nThe L in HSL."),
+    QuantizerOptionItem(&ColorConversion::average,
+                        &ColorConversion::Integer::average, "average",
+                        "Average",
+                        "The average of the RGB values of the pixel"),
+    QuantizerOptionItem(&ColorConversion::minimum,
+                        &ColorConversion::Integer::minimum, "minimum",
+                        "Minimum",
+                        "The smallest of the RGB values of the pixel"),
+    QuantizerOptionItem(&ColorConversion::maximum,
+                        &ColorConversion::Integer::maximum, "maximum",
+                        "Maximum",
+                        "The largest of the RGB values of the pixel"),
+    QuantizerOptionItem(&ColorConversion::chroma,
+                        &ColorConversion::Integer::chroma, "chroma", "Chroma",
+                        "The difference between the maximum and minimum values "
+                        "of the RGB values of the pixel.\n Effectivly: how "
+                        "different a color is from the nearest gray")
+
+};
+
+const int quantizer_options_count = arrayLen(quantizer_options);
+
+const QuantizerOptionItem *findQuantizer(const std::string &id) {
+  for (int i = 0; i < quantizer_options_count; i++) {
+    if (quantizer_options[i].id == id) {
+      return &quantizer_options[i];
+    }
+  }
+  return NULL;
+}
+
+const PixelSorter_value_t *quantizePixels(const QuantizerOptionItem &quantizer,
+                                          KeyPlane &keyPlane,
+                                          const ImageView &image,
+                                          ThreadPool *pool,
+                                          const SortProgress *progress,
+                                          const SortPaging *paging) {
+  // Converters without an integer version may have a lookup table, which is
+  // of no use to deeper pixels
+  const ColorTable *table = NULL;
+  if (quantizer.integerFunction == NULL && !isDeepFormat(image.format)) {
+    table = ColorTable::get(quantizer.function, quantizer.id, pool);
+  }
+  return keyPlane.update(image, quantizer.function, quantizer.integerFunction,
+                         table, pool, progress, paging);
+}
+
+const PixelSorter_wideValue_t *
+quantizePixelsWide(const QuantizerOptionItem &quantizer, KeyPlane &keyPlane,
+                   const ImageView &image, int keyBits, ThreadPool *pool,
+                   const SortProgress *progress, const SortPaging *paging) {
+  return keyPlane.updateWide(image, quantizer.function, keyBits, pool,
+                             progress, paging);
+}
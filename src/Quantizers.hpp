@@ -0,0 +1,69 @@
+/*
+ * The pixel quantizers (ColorConverters) a sort can be keyed on, shared by the
+ * GUI and the command line program.
+ */
+
+#ifndef QUANTIZERS_HPP_
+#define QUANTIZERS_HPP_
+
+#include "ColorConversion.hpp"
+#include "ColorConversionInteger.hpp"
+#include "ImageView.hpp"
+#include "KeyPlane.hpp"
+#include "PixelSorter.hpp"
+#include "ThreadPool.hpp"
+#include <string>
+
+// Simple class, would be a struct, but constructors are nice
+class QuantizerOptionItem {
+public:
+  QuantizerOptionItem(ColorConverter *function,
+                      IntegerColorConverter *integerFunction, std::string id,
+                      std::string name, std::string tooltip) {
+    this->function = function;
+    this->integerFunction = integerFunction;
+    this->id = id;
+    this->name = name;
+    this->tooltip = tooltip;
+  }
+  ColorConverter *function; // ColorConverter function this repersents
+  // Exact integer version of function, used by the sorter instead of function
+  // when it is not NULL
+  IntegerColorConverter *integerFunction;
+  std::string id; // Unique short name, used to name files such as ColorTables
+  // Use char* instead of std::string as that is what DearImGui uses
+  // This removes a step every frame
+  std::string name;    // The name of this option (what is shown in the list)
+  std::string tooltip; // The tooltip that is displayed over the item
+};
+
+// The options that repersent the pixel quantizers
+extern const QuantizerOptionItem quantizer_options[];
+// Number of items in quantizer_options
+extern const int quantizer_options_count;
+
+// Find the quantizer with the id, returns NULL if there is none
+const QuantizerOptionItem *findQuantizer(const std::string &id);
+
+/*
+ * Get the value of every pixel of image with quantizer, cached in keyPlane.
+ * Picks the fastest conversion quantizer has: its integer version, or
+ * otherwise a ColorTable if one fits in the memory budget.
+ * If paging is not NULL the pixels are converted in chunks that keep to it.
+ * Returns NULL if progress is cancelled before every pixel is converted.
+ */
+const PixelSorter_value_t *quantizePixels(const QuantizerOptionItem &quantizer,
+                                          KeyPlane &keyPlane,
+                                          const ImageView &image,
+                                          ThreadPool *pool = NULL,
+                                          const SortProgress *progress = NULL,
+                                          const SortPaging *paging = NULL);
+
+// The same as quantizePixels, but with keys of keyBits bits (12 or 16)
+const PixelSorter_wideValue_t *
+quantizePixelsWide(const QuantizerOptionItem &quantizer, KeyPlane &keyPlane,
+                   const ImageView &image, int keyBits, ThreadPool *pool = NULL,
+                   const SortProgress *progress = NULL,
+                   const SortPaging *paging = NULL);
+
+#endif // QUANTIZERS_HPP_
@@ -0,0 +1,129 @@
+#include "SortWorker.hpp"
+
+bool SortJob::isDone() const {
+  State current = state();
+  return current == FINISHED || current == CANCELLED || current == FAILED;
+}
+
+SortWorker::SortWorker() {
+  thread = std::thread(&SortWorker::workerLoop, this);
+}
+
+SortWorker::~SortWorker() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+    if (pending != nullptr) {
+      pending->currentState = SortJob::CANCELLED;
+      pending = nullptr;
+    }
+    if (running != nullptr) {
+      running->cancel();
+    }
+  }
+  wakeCondition.notify_all();
+  thread.join();
+}
+
+std::shared_ptr<SortJob> SortWorker::submit(const SortRequest &request) {
+  std::shared_ptr<SortJob> job = std::make_shared<SortJob>(request);
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    // The new job replaces every older one
+    if (pending != nullptr) {
+      pending->currentState = SortJob::CANCELLED;
+    }
+    if (running != nullptr) {
+      running->cancel();
+    }
+    pending = job;
+  }
+  wakeCondition.notify_all();
+  return job;
+}
+
+void SortWorker::cancelAndWait() {
+  std::unique_lock<std::mutex> lock(mutex);
+  if (pending != nullptr) {
+    pending->currentState = SortJob::CANCELLED;
+    pending = nullptr;
+  }
+  if (running != nullptr) {
+    running->cancel();
+  }
+  idleCondition.wait(lock, [&] { return isIdle(); });
+}
+
+void SortWorker::wait() {
+  std::unique_lock<std::mutex> lock(mutex);
+  idleCondition.wait(lock, [&] { return isIdle(); });
+}
+
+void SortWorker::invalidateKeys() {
+  cancelAndWait();
+  // No job is running, so the key plane is not in use
+  keyPlane.invalidate();
+}
+
+void SortWorker::workerLoop() {
+  std::unique_lock<std::mutex> lock(mutex);
+  while (true) {
+    wakeCondition.wait(lock, [&] { return stopping || pending != nullptr; });
+    if (stopping) {
+      return;
+    }
+    running = std::move(pending);
+    pending = nullptr;
+    lock.unlock();
+    run(*running);
+    lock.lock();
+    running = nullptr;
+    if (isIdle()) {
+      idleCondition.notify_all();
+    }
+  }
+}
+
+void SortWorker::run(SortJob &job) {
+  if (job.sortProgress.isCancelled()) {
+    job.currentState = SortJob::CANCELLED;
+    return;
+  }
+  job.currentState = SortJob::RUNNING;
+  const SortRequest &request = job.request;
+
+  // (Re)create the pool only when the thread count has changed
+  int threadCount = request.threadCount > 0 ? request.threadCount
+                                            : ThreadPool::hardwareThreads();
+  if (pool == nullptr || pool->size() != threadCount) {
+    pool = std::make_unique<ThreadPool>(threadCount);
+  }
+
+  // Only converts the pixels if the image, converter or precision changed
+  bool sorted;
+  if (request.keyBits > 8) {
+    const PixelSorter_wideValue_t *keys =
+        quantizePixelsWide(*request.quantizer, keyPlane, request.input,
+                           request.keyBits, pool.get(), &job.sortProgress);
+    sorted = keys != NULL &&
+             PixelSorter::sortImage(request.input, request.output,
+                                    request.angle, request.valueMin,
+                                    request.valueMax, keys, request.keyBits,
+                                    workspace, pool.get(), &job.sortProgress);
+  } else {
+    const PixelSorter_value_t *keys =
+        quantizePixels(*request.quantizer, keyPlane, request.input, pool.get(),
+                       &job.sortProgress);
+    sorted = keys != NULL &&
+             PixelSorter::sortImage(request.input, request.output,
+                                    request.angle, request.valueMin,
+                                    request.valueMax, keys, workspace,
+                                    pool.get(), &job.sortProgress);
+  }
+
+  if (job.sortProgress.isCancelled()) {
+    job.currentState = SortJob::CANCELLED;
+  } else {
+    job.currentState = sorted ? SortJob::FINISHED : SortJob::FAILED;
+  }
+}
@@ -0,0 +1,100 @@
+/*
+ * Sorts images on a background thread, so that the GUI keeps drawing (and can
+ * show progress) while a large image is being sorted.
+ *
+ * Only one sort runs at a time. Starting a sort cancels the ones that have not
+ * finished instead of queueing behind them, as only the newest settings
+ * matter.
+ */
+
+#ifndef SORTWORKER_HPP_
+#define SORTWORKER_HPP_
+
+#include "ImageView.hpp"
+#include "KeyPlane.hpp"
+#include "PixelSorter.hpp"
+#include "Quantizers.hpp"
+#include "SortWorkspace.hpp"
+#include "ThreadPool.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+// The settings of a single sort
+struct SortRequest {
+  ImageView input;
+  ImageView output;
+  double angle;    // In degrees, see PixelSorter::sortImage
+  double valueMin; // 0 to 1
+  double valueMax; // 0 to 1
+  const QuantizerOptionItem *quantizer;
+  int threadCount; // 0 or less uses one thread per core
+  int keyBits = 8; // Bits of each key, see PixelSorter::keyBitsSupported
+};
+
+// Handle to a single sort given to a SortWorker
+class SortJob {
+public:
+  enum State { QUEUED, RUNNING, FINISHED, CANCELLED, FAILED };
+
+  SortJob(const SortRequest &request) : request(request) {}
+
+  State state() const { return currentState.load(); }
+  // True once the job will never touch its images again
+  bool isDone() const;
+  // Fraction of the lines sorted, 0 to 1
+  float progress() const { return sortProgress.fraction(); }
+  // Stop the job. A running job notices within a line (or a row of keys),
+  // leaving its output partly sorted
+  void cancel() { sortProgress.cancelled = true; }
+
+  const SortRequest request;
+
+private:
+  friend class SortWorker;
+  std::atomic<State> currentState{QUEUED};
+  SortProgress sortProgress;
+};
+
+class SortWorker {
+public:
+  SortWorker();
+  // Cancels any job, and waits for the thread to stop
+  ~SortWorker();
+
+  // Start sorting request, cancelling every job that has not finished. The
+  // images of request must not be changed or freed until the job is done
+  std::shared_ptr<SortJob> submit(const SortRequest &request);
+
+  // Cancel every job, and wait until none are running. Call this before
+  // changing or freeing images that a job may be using
+  void cancelAndWait();
+  // Wait until every job is done
+  void wait();
+
+  // Forget the cached keys of the input image, after cancelling every job.
+  // Must be called when the pixels of an input image are changed or replaced
+  void invalidateKeys();
+
+private:
+  void workerLoop();
+  void run(SortJob &job);
+  bool isIdle() const { return pending == nullptr && running == nullptr; }
+
+  std::thread thread;
+  std::mutex mutex; // Guards pending, running and stopping
+  std::condition_variable wakeCondition;
+  std::condition_variable idleCondition;
+  std::shared_ptr<SortJob> pending; // The next job to run
+  std::shared_ptr<SortJob> running; // The job being run
+  bool stopping = false;
+
+  /* Only used while running a job */
+  KeyPlane keyPlane;
+  SortWorkspace workspace;
+  std::unique_ptr<ThreadPool> pool;
+};
+
+#endif // SORTWORKER_HPP_
@@ -0,0 +1,65 @@
+#include "SortWorkspace.hpp"
+#include <algorithm>
+
+void SortWorkspace::reserve(int workerCount, int numPoints, int lines,
+                            int keyBits, int pixelBytes) {
+  if ((int)workers.size() < workerCount) {
+    workers.resize(workerCount);
+  }
+  size_t points = (size_t)numPoints * lines;
+  // Keys too wide to count are radix sorted, which needs fewer counts
+  size_t counts = (size_t)1 << std::min(keyBits, PIXELSORTER_COUNTING_BITS);
+  for (Buffers &buffers : workers) {
+    // resize only reallocates if the lines are longer than any before them
+    if (buffers.pixelIndexes.size() < points) {
+      buffers.pixelIndexes.resize(points);
+    }
+    if (buffers.pixels.size() < points * pixelBytes) {
+      buffers.pixels.resize(points * pixelBytes);
+    }
+    if (keyBits > 8 && buffers.wideValues.size() < points) {
+      buffers.wideValues.resize(points);
+    } else if (keyBits <= 8 && buffers.values.size() < points) {
+      buffers.values.resize(points);
+    }
+    if (buffers.order.size() < 2 * (size_t)numPoints) {
+      buffers.order.resize(2 * (size_t)numPoints);
+    }
+    if (buffers.count.size() < counts) {
+      buffers.count.resize(counts);
+    }
+  }
+}
+
+void SortWorkspace::reserveStrips(int workerCount, int stripPixels,
+                                  int keyBits, int pixelBytes) {
+  size_t stripBytes = (size_t)stripPixels * pixelBytes;
+  for (int worker = 0; worker < workerCount; worker++) {
+    Buffers &buffers = workers[worker];
+    if (buffers.stripInput.size() < stripBytes) {
+      buffers.stripInput.resize(stripBytes);
+      buffers.stripOutput.resize(stripBytes);
+    }
+    if (keyBits > 8 && (int)buffers.wideStripKeys.size() < stripPixels) {
+      buffers.wideStripKeys.resize(stripPixels);
+    } else if (keyBits <= 8 && (int)buffers.stripKeys.size() < stripPixels) {
+      buffers.stripKeys.resize(stripPixels);
+    }
+  }
+}
+
+const SortWorkspace::Line &SortWorkspace::line(double angle, int width,
+                                               int height) {
+  Line &line = cachedLine;
+  if (line.runs.numPoints == 0 || line.angle != angle || line.width != width ||
+      line.height != height) {
+    line.angle = angle;
+    line.width = width;
+    line.height = height;
+    line.generatedAngle = angle;
+    line.args.init(0, 0, 0, 0);
+    LineCollision::generateLineRunsForRect(line.generatedAngle, width, height,
+                                           line.args, line.runs);
+  }
+  return line;
+}
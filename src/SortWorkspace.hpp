@@ -0,0 +1,102 @@
+/*
+ * Scratch memory used while sorting, kept between sorts so that sorting a line
+ * never has to allocate.
+ */
+
+#ifndef SORTWORKSPACE_HPP_
+#define SORTWORKSPACE_HPP_
+
+#include "LineCollision.hpp"
+#include "LineInterpolator.hpp"
+#include "PixelSorter.hpp"
+#include <vector>
+
+class SortWorkspace {
+public:
+  // The buffers used by a single worker, each one line long
+  struct Buffers {
+    std::vector<int> pixelIndexes;           // lineIndex to pixelIndex
+    std::vector<PixelSorter_value_t> values; // lineIndex to value
+    std::vector<PixelSorter_wideValue_t> wideValues; // values of wide keys
+    // lineIndex to input pixel. Pixels are of any type (see pixelsOf), so
+    // this is bytes, which operator new aligns enough for any of them
+    std::vector<unsigned char> pixels;
+    std::vector<Count_t> count;              // Count of each value in a band
+    std::vector<int> order; // Order of the pixels of a band, two lines long
+
+    /* A strip of columns copied into rows, used when sorting along columns */
+    std::vector<unsigned char> stripInput;  // Bytes, as pixels is
+    std::vector<unsigned char> stripOutput; // Bytes, as pixels is
+    std::vector<PixelSorter_value_t> stripKeys;
+    std::vector<PixelSorter_wideValue_t> wideStripKeys;
+
+    // values or wideValues, whichever holds keys of type KeyT
+    template <typename KeyT> KeyT *valuesOf();
+    // stripKeys or wideStripKeys, whichever holds keys of type KeyT
+    template <typename KeyT> KeyT *stripKeysOf();
+    // Each buffer of pixels, as pixels of type PixelT
+    template <typename PixelT> PixelT *pixelsOf() {
+      return (PixelT *)pixels.data();
+    }
+    template <typename PixelT> PixelT *stripInputOf() {
+      return (PixelT *)stripInput.data();
+    }
+    template <typename PixelT> PixelT *stripOutputOf() {
+      return (PixelT *)stripOutput.data();
+    }
+  };
+
+  // The line that every line of a sort is a copy of. Only generated again
+  // when the angle or the size of the image changes
+  struct Line {
+    double angle = -1; // Angle asked for, before generating changes it
+    int width = 0;
+    int height = 0;
+    double generatedAngle = 0; // Angle after generating
+    BresenhamsArguments args;
+    LineCollision::LineRuns runs;
+  };
+
+  /*
+   * Make sure there are buffers for workerCount workers, which can each hold
+   * lines lines of numPoints points, keyed by keys of keyBits bits, of pixels
+   * that each take pixelBytes. Memory is only allocated when the workspace
+   * has to grow, so reusing a workspace for the same image never allocates.
+   */
+  void reserve(int workerCount, int numPoints, int lines = 1,
+               int keyBits = 8,
+               int pixelBytes = sizeof(PixelSorter_Pixel_t));
+  // Make sure the first workerCount workers (no more than given to reserve)
+  // each have strip buffers that can hold stripPixels pixels
+  void reserveStrips(int workerCount, int stripPixels, int keyBits = 8,
+                     int pixelBytes = sizeof(PixelSorter_Pixel_t));
+
+  // The buffers of worker, which must be less than the reserved workerCount
+  Buffers &buffers(int worker) { return workers[worker]; }
+
+  // The line at angle for a width by height image, generating it if needed
+  const Line &line(double angle, int width, int height);
+
+private:
+  std::vector<Buffers> workers;
+  Line cachedLine;
+};
+
+template <>
+inline PixelSorter_value_t *SortWorkspace::Buffers::valuesOf() {
+  return values.data();
+}
+template <>
+inline PixelSorter_wideValue_t *SortWorkspace::Buffers::valuesOf() {
+  return wideValues.data();
+}
+template <>
+inline PixelSorter_value_t *SortWorkspace::Buffers::stripKeysOf() {
+  return stripKeys.data();
+}
+template <>
+inline PixelSorter_wideValue_t *SortWorkspace::Buffers::stripKeysOf() {
+  return wideStripKeys.data();
+}
+
+#endif // SORTWORKSPACE_HPP_
@@ -0,0 +1,26 @@
+#include "SurfaceImageView.hpp"
+#include "SDL_pixels.h"
+
+bool imageViewOfSurface(SDL_Surface *surface, ImageView &view) {
+  switch (surface->format->format) {
+  case SDL_PIXELFORMAT_ABGR8888:
+    view.format = PIXELFORMAT_ABGR8888;
+    break;
+  case SDL_PIXELFORMAT_ARGB8888:
+    view.format = PIXELFORMAT_ARGB8888;
+    break;
+  case SDL_PIXELFORMAT_RGBA8888:
+    view.format = PIXELFORMAT_RGBA8888;
+    break;
+  case SDL_PIXELFORMAT_BGRA8888:
+    view.format = PIXELFORMAT_BGRA8888;
+    break;
+  default:
+    return false;
+  }
+  view.pixels = (uint32_t *)surface->pixels;
+  view.width = surface->w;
+  view.height = surface->h;
+  view.stride = surface->pitch;
+  return true;
+}
@@ -0,0 +1,15 @@
+/*
+ * Lets the sorting core, which does not know about SDL, work on SDL_Surfaces
+ */
+
+#ifndef SURFACEIMAGEVIEW_HPP_
+#define SURFACEIMAGEVIEW_HPP_
+
+#include "ImageView.hpp"
+#include "SDL_surface.h"
+
+// Fill view with the pixels of surface. Returns false if surface is not in a
+// PixelFormat the sorter understands
+bool imageViewOfSurface(SDL_Surface *surface, ImageView &view);
+
+#endif // SURFACEIMAGEVIEW_HPP_
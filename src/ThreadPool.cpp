@@ -0,0 +1,96 @@
+#include "ThreadPool.hpp"
+#include <algorithm>
+
+ThreadPool::ThreadPool(int threadCount) {
+  if (threadCount <= 0) {
+    threadCount = hardwareThreads();
+  }
+  // The thread calling parallelFor is worker 0, so start one less thread
+  for (int worker = 1; worker < threadCount; worker++) {
+    threads.emplace_back(&ThreadPool::workerLoop, this, worker);
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  wakeCondition.notify_all();
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+}
+
+int ThreadPool::size() const { return threads.size() + 1; }
+
+int ThreadPool::hardwareThreads() {
+  return std::max(1u, std::thread::hardware_concurrency());
+}
+
+void ThreadPool::parallelFor(int begin, int end, int blockSize,
+                             const ThreadPoolTask &task) {
+  if (begin >= end) {
+    return;
+  }
+  blockSize = std::max(1, blockSize);
+  // Nothing to share, skip waking the workers
+  if (threads.empty() || end - begin <= blockSize) {
+    task(begin, end, 0);
+    return;
+  }
+
+  std::lock_guard<std::mutex> callLock(callMutex);
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    this->task = &task;
+    this->begin = begin;
+    this->end = end;
+    this->blockSize = blockSize;
+    nextBlock = 0;
+    busyWorkers = threads.size();
+    generation++;
+  }
+  wakeCondition.notify_all();
+
+  runBlocks(0);
+
+  // Wait for the background workers to finish their last blocks
+  std::unique_lock<std::mutex> lock(mutex);
+  doneCondition.wait(lock, [this] { return busyWorkers == 0; });
+  this->task = nullptr;
+}
+
+void ThreadPool::runBlocks(int worker) {
+  while (true) {
+    long blockStart = begin + (long)(nextBlock++) * blockSize;
+    if (blockStart >= end) {
+      return;
+    }
+    int blockEnd = (int)std::min((long)end, blockStart + blockSize);
+    (*task)((int)blockStart, blockEnd, worker);
+  }
+}
+
+void ThreadPool::workerLoop(int worker) {
+  unsigned long lastGeneration = 0;
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      wakeCondition.wait(lock, [this, lastGeneration] {
+        return stopping || generation != lastGeneration;
+      });
+      if (stopping) {
+        return;
+      }
+      lastGeneration = generation;
+    }
+
+    runBlocks(worker);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (--busyWorkers == 0) {
+      doneCondition.notify_one();
+    }
+  }
+}
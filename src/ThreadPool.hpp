@@ -0,0 +1,63 @@
+/*
+ * A small pool of persistent worker threads, used to split a range of work
+ * (such as the lines of an image) across every core of the machine.
+ */
+
+#ifndef THREADPOOL_HPP_
+#define THREADPOOL_HPP_
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Work done on the half open range [begin, end) by the worker with index
+// worker, which is always in the range [0, ThreadPool::size())
+typedef std::function<void(int begin, int end, int worker)> ThreadPoolTask;
+
+class ThreadPool {
+public:
+  // Create a pool of threadCount workers. 0 or less uses one worker per core
+  ThreadPool(int threadCount = 0);
+  ~ThreadPool();
+
+  // The number of workers, including the thread calling parallelFor
+  int size() const;
+
+  /*
+   * Split [begin, end) into blocks of at most blockSize and run task on each
+   * block, spread across all workers. Blocks are handed out in order.
+   * The calling thread works as worker 0, and this only returns once every
+   * block is done. Calls from multiple threads are run one at a time.
+   */
+  void parallelFor(int begin, int end, int blockSize,
+                   const ThreadPoolTask &task);
+
+  // The number of cores on this machine, never less than 1
+  static int hardwareThreads();
+
+private:
+  void workerLoop(int worker);
+  // Take blocks from the current job until there are none left
+  void runBlocks(int worker);
+
+  std::vector<std::thread> threads;
+  std::mutex callMutex; // Only one parallelFor at a time
+  std::mutex mutex;     // Guards everything below
+  std::condition_variable wakeCondition;
+  std::condition_variable doneCondition;
+
+  /* The current job */
+  const ThreadPoolTask *task = nullptr;
+  int begin = 0;
+  int end = 0;
+  int blockSize = 1;
+  std::atomic<int> nextBlock{0};
+  int busyWorkers = 0;          // Background workers still on this job
+  unsigned long generation = 0; // Incremented for each job
+  bool stopping = false;
+};
+
+#endif // THREADPOOL_HPP_
@@ -0,0 +1,335 @@
+#include "ImageFile.hpp"
+#include <climits>
+#include <png.h>
+
+// Bytes of a png file needed to read its bit depth: the signature, then the
+// length, type, width and height of the IHDR chunk before the depth
+#define PNG_DEPTH_OFFSET 24
+
+bool isDeepPng(const std::string &path) {
+  FILE *file = fopen(path.c_str(), "rb");
+  if (file == NULL) {
+    return false;
+  }
+  png_byte header[PNG_DEPTH_OFFSET + 1];
+  bool deep = fread(header, 1, sizeof(header), file) == sizeof(header) &&
+              png_sig_cmp(header, 0, 8) == 0 &&
+              header[PNG_DEPTH_OFFSET] == 16;
+  fclose(file);
+  return deep;
+}
+
+PixelFormat pngPixelFormat(bool deep) {
+  if (deep) {
+    return PIXELFORMAT_RGBA64;
+  }
+  // libpng gives the bytes of a pixel in RGBA order
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  return PIXELFORMAT_ABGR8888;
+#else
+  return PIXELFORMAT_RGBA8888;
+#endif
+}
+
+// Private helper to open the png at path for reading, and read its info.
+// Returns false, with nothing left open, on failure
+static bool openPng(const std::string &path, FILE *&file, png_structp &png,
+                    png_infop &info) {
+  file = fopen(path.c_str(), "rb");
+  if (file == NULL) {
+    fprintf(stderr, "Could not open %s\n", path.c_str());
+    return false;
+  }
+  png = png_create_read_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+  info = png == NULL ? NULL : png_create_info_struct(png);
+  if (info == NULL) {
+    png_destroy_read_struct(&png, NULL, NULL);
+    fclose(file);
+    return false;
+  }
+  // libpng jumps back here on any error, after printing it
+  if (setjmp(png_jmpbuf(png))) {
+    fprintf(stderr, "Could not load %s\n", path.c_str());
+    png_destroy_read_struct(&png, &info, NULL);
+    fclose(file);
+    return false;
+  }
+  png_init_io(png, file);
+  png_read_info(png, info);
+  if (png_get_image_width(png, info) > INT_MAX / sizeof(PixelRGBA16) ||
+      png_get_image_height(png, info) > INT_MAX) {
+    png_error(png, "Image is too large");
+  }
+  return true;
+}
+
+// Private helper to get what the png read by png holds
+static PngInfo pngInfoOf(png_structp png, png_infop info) {
+  PngInfo pngInfo;
+  pngInfo.width = png_get_image_width(png, info);
+  pngInfo.height = png_get_image_height(png, info);
+  pngInfo.deep = png_get_bit_depth(png, info) == 16;
+  pngInfo.interlaced =
+      png_get_interlace_type(png, info) != PNG_INTERLACE_NONE;
+  return pngInfo;
+}
+
+bool readPngInfo(const std::string &path, PngInfo &info) {
+  FILE *file;
+  png_structp png;
+  png_infop pngInfo;
+  if (!openPng(path, file, png, pngInfo)) {
+    return false;
+  }
+  info = pngInfoOf(png, pngInfo);
+  png_destroy_read_struct(&png, &pngInfo, NULL);
+  fclose(file);
+  return true;
+}
+
+PngReader::~PngReader() { close(); }
+
+void PngReader::close() {
+  if (png != NULL) {
+    png_destroy_read_struct(&png, &pngInfoStruct, NULL);
+  }
+  if (file != NULL) {
+    fclose(file);
+    file = NULL;
+  }
+}
+
+bool PngReader::open(const std::string &path, PixelFormat format) {
+  bool deep = format == PIXELFORMAT_RGBA64;
+  if (format != pngPixelFormat(deep)) {
+    fprintf(stderr, "Can not read a png into this pixel format\n");
+    return false;
+  }
+  close();
+  this->path = path;
+  rowsRead = 0;
+  if (!openPng(path, file, png, pngInfoStruct)) {
+    file = NULL;
+    png = NULL;
+    return false;
+  }
+  // libpng jumps back here on any error, after printing it
+  if (setjmp(png_jmpbuf(png))) {
+    fprintf(stderr, "Could not load %s\n", path.c_str());
+    close();
+    return false;
+  }
+  pngInfo = pngInfoOf(png, pngInfoStruct);
+  // Turn every kind of png into RGBA of the depth of format
+  png_set_expand(png);
+  if (deep) {
+    png_set_expand_16(png);
+  } else {
+    png_set_strip_16(png);
+  }
+  png_set_gray_to_rgb(png);
+  if (!(png_get_color_type(png, pngInfoStruct) & PNG_COLOR_MASK_ALPHA) &&
+      !png_get_valid(png, pngInfoStruct, PNG_INFO_tRNS)) {
+    png_set_add_alpha(png, deep ? 0xffff : 0xff, PNG_FILLER_AFTER);
+  }
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  if (deep) {
+    png_set_swap(png); // pngs are big endian
+  }
+#endif
+  // Interlaced pngs fill in every row on each pass
+  passes = png_set_interlace_handling(png);
+  png_read_update_info(png, pngInfoStruct);
+  return true;
+}
+
+bool PngReader::readRows(const ImageView &rows) {
+  if (png == NULL || rows.width != pngInfo.width ||
+      rowsRead + rows.height > pngInfo.height ||
+      (passes > 1 && rows.height != pngInfo.height)) {
+    fprintf(stderr, "Could not load %s, rows do not fit\n", path.c_str());
+    return false;
+  }
+  // libpng jumps back here on any error, after printing it
+  if (setjmp(png_jmpbuf(png))) {
+    fprintf(stderr, "Could not load %s\n", path.c_str());
+    close();
+    return false;
+  }
+  for (int pass = 0; pass < passes; pass++) {
+    for (int y = 0; y < rows.height; y++) {
+      png_read_row(png, (png_bytep)rows.pixels + (size_t)y * rows.stride,
+                   NULL);
+    }
+  }
+  rowsRead += rows.height;
+  return true;
+}
+
+bool PngReader::finish() {
+  if (png == NULL || rowsRead != pngInfo.height) {
+    return false;
+  }
+  // libpng jumps back here on any error, after printing it
+  if (setjmp(png_jmpbuf(png))) {
+    fprintf(stderr, "Could not load %s\n", path.c_str());
+    close();
+    return false;
+  }
+  png_read_end(png, NULL);
+  close();
+  return true;
+}
+
+PngWriter::~PngWriter() { close(); }
+
+void PngWriter::close() {
+  if (png != NULL) {
+    png_destroy_write_struct(&png, &pngInfoStruct);
+  }
+  if (file != NULL) {
+    fclose(file);
+    file = NULL;
+  }
+}
+
+bool PngWriter::open(const std::string &path, int width, int height,
+                     PixelFormat format, int level) {
+  bool deep = format == PIXELFORMAT_RGBA64;
+  if (format != pngPixelFormat(deep)) {
+    fprintf(stderr, "Can not write a png from this pixel format\n");
+    return false;
+  }
+  close();
+  this->path = path;
+  this->height = height;
+  rowsWritten = 0;
+  file = fopen(path.c_str(), "wb");
+  if (file == NULL) {
+    fprintf(stderr, "Could not open %s\n", path.c_str());
+    return false;
+  }
+  png = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+  pngInfoStruct = png == NULL ? NULL : png_create_info_struct(png);
+  if (pngInfoStruct == NULL) {
+    close();
+    return false;
+  }
+  // libpng jumps back here on any error, after printing it
+  if (setjmp(png_jmpbuf(png))) {
+    fprintf(stderr, "Could not save %s\n", path.c_str());
+    close();
+    return false;
+  }
+  png_init_io(png, file);
+  png_set_compression_level(png, level);
+  png_set_IHDR(png, pngInfoStruct, width, height, deep ? 16 : 8,
+               PNG_COLOR_TYPE_RGBA, PNG_INTERLACE_NONE,
+               PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+  png_write_info(png, pngInfoStruct);
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  if (deep) {
+    png_set_swap(png); // pngs are big endian
+  }
+#endif
+  return true;
+}
+
+bool PngWriter::writeRows(const ImageView &rows) {
+  if (png == NULL || rowsWritten + rows.height > height) {
+    return false;
+  }
+  // libpng jumps back here on any error, after printing it
+  if (setjmp(png_jmpbuf(png))) {
+    fprintf(stderr, "Could not save %s\n", path.c_str());
+    close();
+    return false;
+  }
+  for (int y = 0; y < rows.height; y++) {
+    png_write_row(png, (png_const_bytep)rows.pixels + (size_t)y * rows.stride);
+  }
+  rowsWritten += rows.height;
+  return true;
+}
+
+bool PngWriter::finish() {
+  if (png == NULL || rowsWritten != height) {
+    return false;
+  }
+  // libpng jumps back here on any error, after printing it
+  if (setjmp(png_jmpbuf(png))) {
+    fprintf(stderr, "Could not save %s\n", path.c_str());
+    close();
+    return false;
+  }
+  png_write_end(png, NULL);
+  png_destroy_write_struct(&png, &pngInfoStruct);
+  // Data may still be buffered, only closing shows if it could be written
+  bool closed = fclose(file) == 0;
+  file = NULL;
+  return closed;
+}
+
+bool readPng(const std::string &path, const ImageView &image,
+             const std::function<void(int row)> &rowDone) {
+  PngReader reader;
+  if (!reader.open(path, image.format)) {
+    return false;
+  }
+  const PngInfo &info = reader.info();
+  if (info.width != image.width || info.height != image.height) {
+    fprintf(stderr, "%s is not the size expected\n", path.c_str());
+    return false;
+  }
+  // Rows of interlaced pngs are only read for good on the last pass
+  if (info.interlaced) {
+    if (!reader.readRows(image)) {
+      return false;
+    }
+    for (int y = 0; rowDone && y < image.height; y++) {
+      rowDone(y);
+    }
+    return reader.finish();
+  }
+  for (int y = 0; y < image.height; y++) {
+    if (!reader.readRows(image.rows(y, 1))) {
+      return false;
+    }
+    if (rowDone) {
+      rowDone(y);
+    }
+  }
+  return reader.finish();
+}
+
+bool writePng(const std::string &path, const ImageView &image,
+              const std::function<void(int row)> &rowDone, int level) {
+  PngWriter writer;
+  if (!writer.open(path, image.width, image.height, image.format, level)) {
+    return false;
+  }
+  for (int y = 0; y < image.height; y++) {
+    if (!writer.writeRows(image.rows(y, 1))) {
+      return false;
+    }
+    if (rowDone) {
+      rowDone(y);
+    }
+  }
+  return writer.finish();
+}
+
+bool loadDeepPng(const std::string &path, std::vector<PixelRGBA16> &pixels,
+                 ImageView &view) {
+  PngInfo info;
+  if (!readPngInfo(path, info)) {
+    return false;
+  }
+  pixels.resize((size_t)info.width * info.height);
+  view.pixels = pixels.data();
+  view.width = info.width;
+  view.height = info.height;
+  view.stride = info.width * sizeof(PixelRGBA16);
+  view.format = PIXELFORMAT_RGBA64;
+  return readPng(path, view);
+}
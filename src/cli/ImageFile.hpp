@@ -0,0 +1,127 @@
+/*
+ * Reading and writing images that SDL_image can not keep whole. SDL surfaces
+ * only have 8 bits per channel, so pngs with 16 bits per channel are read and
+ * written with libpng directly. libpng also reads and writes pngs a row at a
+ * time, into and out of images too big to load as a surface.
+ */
+
+#ifndef IMAGEFILE_HPP_
+#define IMAGEFILE_HPP_
+
+#include "ImageView.hpp"
+#include "PngEncoder.hpp"
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <vector>
+
+// libpng's own types, so that its header is only needed by ImageFile.cpp
+struct png_struct_def;
+struct png_info_def;
+
+// What a png holds, without reading its pixels
+struct PngInfo {
+  int width;
+  int height;
+  bool deep;       // 16 bits per channel, otherwise 8 (or fewer)
+  bool interlaced; // Every row is read more than once, so the png can only
+                   // be read whole
+};
+
+// True if the file at path is a png with 16 bits per channel
+bool isDeepPng(const std::string &path);
+
+// Get the size and kind of the png at path. Returns false if it can not be
+// read
+bool readPngInfo(const std::string &path, PngInfo &info);
+
+// The format pngs are read into and written from, for 16 bits per channel if
+// deep, otherwise 8
+PixelFormat pngPixelFormat(bool deep);
+
+// Reads a png a few rows at a time, from the first row to the last
+class PngReader {
+public:
+  PngReader() = default;
+  PngReader(const PngReader &) = delete;
+  PngReader &operator=(const PngReader &) = delete;
+  ~PngReader();
+
+  // Open the png at path to be read into pixels of format, pngPixelFormat of
+  // either depth. Any png can be read, gray ones become RGB and ones without
+  // alpha are opaque. Returns false on failure
+  bool open(const std::string &path, PixelFormat format);
+  // Read the next rows.height rows of the png into rows, which must be as
+  // wide as it and in the format given to open. Interlaced pngs must be read
+  // whole. Returns false on failure
+  bool readRows(const ImageView &rows);
+  // Check the end of the png, after every row has been read. Returns false on
+  // failure
+  bool finish();
+
+  const PngInfo &info() const { return pngInfo; }
+
+private:
+  void close();
+
+  std::string path;
+  FILE *file = NULL;
+  png_struct_def *png = NULL;
+  png_info_def *pngInfoStruct = NULL;
+  PngInfo pngInfo = {};
+  int passes = 1;
+  int rowsRead = 0;
+};
+
+// Writes a png a few rows at a time, from the first row to the last
+class PngWriter {
+public:
+  PngWriter() = default;
+  PngWriter(const PngWriter &) = delete;
+  PngWriter &operator=(const PngWriter &) = delete;
+  ~PngWriter();
+
+  // Start a width by height png at path, written from pixels of format,
+  // pngPixelFormat of either depth, compressed at level (see savePng).
+  // Returns false on failure
+  bool open(const std::string &path, int width, int height,
+            PixelFormat format, int level = PNG_DEFAULT_COMPRESSION);
+  // Write rows as the next rows.height rows of the png. Returns false on
+  // failure
+  bool writeRows(const ImageView &rows);
+  // End the png, after every row has been written, and close the file.
+  // Returns false on failure
+  bool finish();
+
+private:
+  void close();
+
+  std::string path;
+  FILE *file = NULL;
+  png_struct_def *png = NULL;
+  png_info_def *pngInfoStruct = NULL;
+  int rowsWritten = 0;
+  int height = 0;
+};
+
+// Read the png at path into image, which must be the size of the png and in
+// pngPixelFormat of either depth (see PngReader::open). If rowDone is set it
+// is called with each row once the row is read for good. Returns false on
+// failure
+bool readPng(const std::string &path, const ImageView &image,
+             const std::function<void(int row)> &rowDone = nullptr);
+
+// Write image, in pngPixelFormat of either depth, to path as a png of that
+// depth, a row at a time on this thread (savePng is faster for images held
+// whole). If rowDone is set it is called with each row once it is written.
+// level is the compression level (see savePng). Returns false on failure
+bool writePng(const std::string &path, const ImageView &image,
+              const std::function<void(int row)> &rowDone = nullptr,
+              int level = PNG_DEFAULT_COMPRESSION);
+
+// Load the png at path into pixels, with view set to show them in
+// PIXELFORMAT_RGBA64. Returns false on failure
+bool loadDeepPng(const std::string &path, std::vector<PixelRGBA16> &pixels,
+                 ImageView &view);
+
+#endif // IMAGEFILE_HPP_
@@ -0,0 +1,63 @@
+#include "MappedFile.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <vector>
+
+MappedFile::~MappedFile() {
+  if (memory != NULL) {
+    munmap(memory, length);
+  }
+  if (file != -1) {
+    close(file);
+  }
+}
+
+bool MappedFile::create(const std::string &directory, size_t size) {
+  std::string path = directory + "/pixelsort-XXXXXX";
+  std::vector<char> name(path.begin(), path.end());
+  name.push_back('\0');
+  file = mkstemp(name.data());
+  if (file == -1) {
+    fprintf(stderr, "Could not make a scratch file in %s: %s\n",
+            directory.c_str(), strerror(errno));
+    return false;
+  }
+  unlink(name.data());
+  // mmap can not map nothing
+  size = std::max<size_t>(size, 1);
+  if (ftruncate(file, size) != 0) {
+    fprintf(stderr, "Could not grow a scratch file to %zu bytes: %s\n", size,
+            strerror(errno));
+    return false;
+  }
+  void *mapped = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+  if (mapped == MAP_FAILED) {
+    fprintf(stderr, "Could not map a scratch file: %s\n", strerror(errno));
+    return false;
+  }
+  memory = mapped;
+  length = size;
+  return true;
+}
+
+void MappedFile::release(size_t offset, size_t length) {
+  if (memory == NULL || offset >= this->length) {
+    return;
+  }
+  length = std::min(length, this->length - offset);
+  // Only whole pages can be dropped, so keep the ones the range ends within
+  size_t page = sysconf(_SC_PAGESIZE);
+  size_t start = (offset + page - 1) / page * page;
+  size_t end = offset + length == this->length
+                   ? this->length
+                   : (offset + length) / page * page;
+  if (start < end) {
+    // The mapping is shared, so the pages are written back to the file first
+    madvise((char *)memory + start, end - start, MADV_DONTNEED);
+  }
+}
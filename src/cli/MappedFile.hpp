@@ -0,0 +1,39 @@
+/*
+ * Scratch memory backed by a file on disk instead of RAM, for images too big
+ * to fit in memory. The pages of the file are only read in while they are
+ * used, and can be given back to the system once they are not.
+ */
+
+#ifndef MAPPEDFILE_HPP_
+#define MAPPEDFILE_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+class MappedFile {
+public:
+  MappedFile() = default;
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+  ~MappedFile();
+
+  // Make a scratch file of size bytes in directory, and map it. The file is
+  // deleted straight away, so it goes when it is unmapped, even on a crash.
+  // Returns false on failure
+  bool create(const std::string &directory, size_t size);
+
+  void *data() const { return memory; }
+  size_t size() const { return length; }
+
+  // Drop the pages from offset for length bytes out of memory. What they
+  // hold is kept in the file, and read back in if they are used again
+  void release(size_t offset = 0, size_t length = SIZE_MAX);
+
+private:
+  int file = -1;
+  void *memory = NULL;
+  size_t length = 0;
+};
+
+#endif // MAPPEDFILE_HPP_
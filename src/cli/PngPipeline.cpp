@@ -0,0 +1,123 @@
+#include "PngPipeline.hpp"
+#include "ImageFile.hpp"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Bands handed from one stage of the pipeline to the next
+class BandQueue {
+public:
+  void push(int band) {
+    std::lock_guard<std::mutex> lock(mutex);
+    bands.push_back(band);
+    condition.notify_one();
+  }
+  // No more bands will be pushed
+  void close() {
+    std::lock_guard<std::mutex> lock(mutex);
+    closed = true;
+    condition.notify_all();
+  }
+  // Wait for the next band. Returns false once the queue is closed and empty
+  bool pop(int &band) {
+    std::unique_lock<std::mutex> lock(mutex);
+    condition.wait(lock, [&]() { return !bands.empty() || closed; });
+    if (bands.empty()) {
+      return false;
+    }
+    band = bands.front();
+    bands.pop_front();
+    return true;
+  }
+
+private:
+  std::mutex mutex;
+  std::condition_variable condition;
+  std::deque<int> bands;
+  bool closed = false;
+};
+
+bool pipelinePng(const std::string &inputPath, const std::string &outputPath,
+                 int bandRows, int level,
+                 const std::function<bool(const ImageView &band)> &sortBand) {
+  PngReader reader;
+  PngInfo info;
+  if (!readPngInfo(inputPath, info)) {
+    return false;
+  }
+  if (info.interlaced) {
+    fprintf(stderr, "Can not read interlaced %s a band at a time\n",
+            inputPath.c_str());
+    return false;
+  }
+  PixelFormat format = pngPixelFormat(info.deep);
+  PngWriter writer;
+  if (!reader.open(inputPath, format) ||
+      !writer.open(outputPath, info.width, info.height, format, level)) {
+    return false;
+  }
+
+  bandRows = std::max(1, std::min(bandRows, info.height));
+  int stride = info.width * pixelFormatBytes(format);
+  std::vector<unsigned char> pixels((size_t)PIPELINE_BANDS * bandRows *
+                                    stride);
+  ImageView bands[PIPELINE_BANDS];
+  for (int band = 0; band < PIPELINE_BANDS; band++) {
+    bands[band] = {pixels.data() + (size_t)band * bandRows * stride,
+                   info.width, bandRows, stride, format};
+  }
+
+  // Bands go round from free to decoded to sorted and back to free. Once any
+  // stage fails the others pass bands on without touching them, until the
+  // decoder stops
+  BandQueue freeBands;
+  BandQueue decoded;
+  BandQueue sorted;
+  for (int band = 0; band < PIPELINE_BANDS; band++) {
+    freeBands.push(band);
+  }
+  std::atomic<bool> failed{false};
+
+  std::thread decoder([&]() {
+    for (int firstRow = 0; firstRow < info.height && !failed;
+         firstRow += bandRows) {
+      int band;
+      freeBands.pop(band);
+      bands[band].height = std::min(bandRows, info.height - firstRow);
+      if (failed || !reader.readRows(bands[band])) {
+        failed = true;
+        break;
+      }
+      decoded.push(band);
+    }
+    if (!failed && !reader.finish()) {
+      failed = true;
+    }
+    decoded.close();
+  });
+  std::thread encoder([&]() {
+    int band;
+    while (sorted.pop(band)) {
+      if (!failed && !writer.writeRows(bands[band])) {
+        failed = true;
+      }
+      freeBands.push(band);
+    }
+  });
+
+  int band;
+  while (decoded.pop(band)) {
+    if (!failed && !sortBand(bands[band])) {
+      failed = true;
+    }
+    sorted.push(band);
+  }
+  sorted.close();
+  decoder.join();
+  encoder.join();
+  return !failed && writer.finish();
+}
@@ -0,0 +1,28 @@
+/*
+ * Sorts a png a band of rows at a time, straight from the decoder to the
+ * encoder, for sorts whose lines are the rows of the image. Every row is
+ * sorted on its own, so only a few bands are ever in memory, and decoding,
+ * sorting and encoding each run on their own thread at the same time.
+ */
+
+#ifndef PNGPIPELINE_HPP_
+#define PNGPIPELINE_HPP_
+
+#include "ImageView.hpp"
+#include <functional>
+#include <string>
+
+// Bands in memory at once: one being decoded, one sorted, one encoded, and
+// one spare so that the fastest stage does not wait on the others
+#define PIPELINE_BANDS 4
+
+// Sort the png at inputPath into a png of the same size and depth at
+// outputPath, bandRows rows at a time, compressed at level (see savePng).
+// sortBand is called with each band in order, on the calling thread, to sort
+// it in place, and returns false if it could not. Interlaced pngs can not be
+// read a band at a time. Returns false on failure
+bool pipelinePng(const std::string &inputPath, const std::string &outputPath,
+                 int bandRows, int level,
+                 const std::function<bool(const ImageView &band)> &sortBand);
+
+#endif // PNGPIPELINE_HPP_
@@ -0,0 +1,671 @@
+/*
+ * Command line version of the pixel sorter, for sorting images without a
+ * display. Only uses SDL to load images, so no window, renderer or DearImGui
+ * is ever created. Pngs with 16 bits per channel are loaded with libpng
+ * instead, so they are sorted without losing any bits. Sorted images are
+ * saved as pngs deflated on every thread of the job (see PngEncoder.hpp),
+ * unless the output is a .qoi, .pam or .rgba file (see FastImageFile.hpp),
+ * which are much faster to save and load between passes of a pipeline.
+ *
+ * Pngs too big for memory can be streamed: read a row at a time into scratch
+ * files mapped into memory, sorted a chunk of lines at a time, and written
+ * out a row at a time, dropping pages from memory once they are used. When
+ * the lines are the rows of the image nothing needs to be kept: bands of rows
+ * go straight from the png decoder to the sorter to the encoder, each on its
+ * own thread.
+ *
+ * Many images can be sorted at once by passing a directory or glob as the
+ * input. They are shared out between a fixed number of jobs, each with its
+ * own scratch memory and threads.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <getopt.h>
+#include <glob.h>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "SDL_pixels.h"
+#include "SDL_surface.h"
+#include <SDL_image.h>
+
+// Local includes
+#include "ColorTable.hpp"
+#include "FastImageFile.hpp"
+#include "ImageFile.hpp"
+#include "KeyPlane.hpp"
+#include "MappedFile.hpp"
+#include "PixelSorter.hpp"
+#include "PngEncoder.hpp"
+#include "PngPipeline.hpp"
+#include "Quantizers.hpp"
+#include "SortWorkspace.hpp"
+#include "SurfaceImageView.hpp"
+#include "ThreadPool.hpp"
+#include "global.hpp"
+
+// Most rows in a band when sorting a png along its rows a band at a time.
+// Bands this small keep the decoder, sorter and encoder all busy
+#define STREAM_BAND_ROWS 64
+
+// Everything that controls how the images are sorted
+struct Options {
+  std::vector<std::string> inputs; // Files, directories, or globs
+  std::string output;
+  double angle = 0;         // As shown in the GUI, 0 to 360
+  double percentMin = 25.0; // Range Minimum, 0 to 100
+  double percentMax = 75.0; // Range Maximum, 0 to 100
+  const QuantizerOptionItem *quantizer = &quantizer_options[0];
+  int keyBits = 8; // Precision of the keys, 8, 12 or 16
+  int threads = 0; // Threads per job, 0 picks for us
+  int jobs = 0;    // Images sorted at once, 0 picks for us
+  long tableMemory = 0; // ColorTable memory budget in MiB
+  long streamMemory = 0; // Memory budget in MiB when streaming, 0 to not
+  std::string scratch;   // Directory of the scratch files, empty for output's
+  bool inPlace = false;  // Sort each image over itself, instead of into a copy
+  int compression = PNG_DEFAULT_COMPRESSION; // zlib level of the saved pngs
+};
+
+// A single image to sort
+struct Task {
+  std::string input;
+  std::string output;
+};
+
+static void printUsage(FILE *stream, const char *program) {
+  fprintf(stream,
+          "Usage: %s --input PATH --output PATH [options]\n"
+          "\n"
+          "  -i, --input PATH      Image, directory or glob to sort. May be "
+          "given more\n"
+          "                        than once\n"
+          "  -o, --output PATH     Image to write, or the directory to write "
+          "to when\n"
+          "                        sorting more than one image\n"
+          "  -a, --angle DEGREES   Angle of the lines, 0 to 360 (default 0)\n"
+          "      --min PERCENT     Range Minimum, 0 to 100 (default 25)\n"
+          "      --max PERCENT     Range Maximum, 0 to 100 (default 75)\n"
+          "  -k, --key NAME        Value to sort by (default red), one of:\n"
+          "                       ",
+          program);
+  for (int i = 0; i < quantizer_options_count; i++) {
+    fprintf(stream, " %s", quantizer_options[i].id.c_str());
+  }
+  fprintf(stream,
+          "\n"
+          "  -b, --key-bits N      Precision of the keys, 8, 12 or 16 "
+          "(default 8).\n"
+          "                        More bits make smoother gradients, but "
+          "sort slower\n"
+          "  -t, --threads N       Threads used to sort each image\n"
+          "  -j, --jobs N          Images sorted at the same time\n"
+          "      --table-memory MIB\n"
+          "                        Memory lookup tables may use (default 0, "
+          "off)\n"
+          "      --stream MIB      Sort pngs through scratch files, keeping "
+          "about MIB\n"
+          "                        of each image in memory, for images too "
+          "big for it\n"
+          "      --scratch DIR     Directory of the scratch files (default "
+          "that of\n"
+          "                        the output)\n"
+          "      --in-place        Sort each image over itself instead of "
+          "into a copy,\n"
+          "                        using half the memory\n"
+          "  -z, --compression N   Compression of the saved pngs, 0 (fastest) "
+          "to 9\n"
+          "                        (smallest), default 6\n"
+          "  -h, --help            Show this message\n"
+          "\n"
+          "By default a single image is sorted with one thread per core, and "
+          "many\n"
+          "images are sorted one per core with one thread each.\n");
+}
+
+// Parse a number from text, returns false if text is not entirely a number
+static bool parseNumber(const char *text, double &number) {
+  char *end = NULL;
+  number = strtod(text, &end);
+  return end != text && *end == '\0' && std::isfinite(number);
+}
+
+static bool parseInteger(const char *text, long &number) {
+  char *end = NULL;
+  number = strtol(text, &end, 10);
+  return end != text && *end == '\0';
+}
+
+// Parse the command line into options, returns false on any bad argument
+static bool parseOptions(int argc, char *argv[], Options &options) {
+  enum {
+    OPTION_MIN = 256,
+    OPTION_MAX,
+    OPTION_TABLE_MEMORY,
+    OPTION_STREAM,
+    OPTION_SCRATCH,
+    OPTION_IN_PLACE
+  };
+  static const struct option longOptions[] = {
+      {"input", required_argument, NULL, 'i'},
+      {"output", required_argument, NULL, 'o'},
+      {"angle", required_argument, NULL, 'a'},
+      {"min", required_argument, NULL, OPTION_MIN},
+      {"max", required_argument, NULL, OPTION_MAX},
+      {"key", required_argument, NULL, 'k'},
+      {"key-bits", required_argument, NULL, 'b'},
+      {"threads", required_argument, NULL, 't'},
+      {"jobs", required_argument, NULL, 'j'},
+      {"table-memory", required_argument, NULL, OPTION_TABLE_MEMORY},
+      {"stream", required_argument, NULL, OPTION_STREAM},
+      {"scratch", required_argument, NULL, OPTION_SCRATCH},
+      {"in-place", no_argument, NULL, OPTION_IN_PLACE},
+      {"compression", required_argument, NULL, 'z'},
+      {"help", no_argument, NULL, 'h'},
+      {NULL, 0, NULL, 0}};
+
+  int option;
+  double number;
+  long integer;
+  while ((option = getopt_long(argc, argv, "i:o:a:k:b:t:j:z:h", longOptions,
+                               NULL)) != -1) {
+    switch (option) {
+    case 'i':
+      options.inputs.push_back(optarg);
+      break;
+    case 'o':
+      options.output = optarg;
+      break;
+    case 'a':
+      if (!parseNumber(optarg, number) || number < 0 || number > 360) {
+        fprintf(stderr, "Angle must be between 0 and 360, not %s\n", optarg);
+        return false;
+      }
+      options.angle = number;
+      break;
+    case OPTION_MIN:
+    case OPTION_MAX:
+      if (!parseNumber(optarg, number) || number < 0 || number > 100) {
+        fprintf(stderr, "Range must be between 0 and 100, not %s\n", optarg);
+        return false;
+      }
+      (option == OPTION_MIN ? options.percentMin : options.percentMax) =
+          number;
+      break;
+    case 'k':
+      options.quantizer = findQuantizer(optarg);
+      if (options.quantizer == NULL) {
+        fprintf(stderr, "Unknown key %s, see --help\n", optarg);
+        return false;
+      }
+      break;
+    case 'b':
+      if (!parseInteger(optarg, integer) ||
+          !PixelSorter::keyBitsSupported(integer)) {
+        fprintf(stderr, "--key-bits must be 8, 12 or 16, not %s\n", optarg);
+        return false;
+      }
+      options.keyBits = integer;
+      break;
+    case 't':
+    case 'j':
+      if (!parseInteger(optarg, integer) || integer < 1) {
+        fprintf(stderr, "--%s must be at least 1, not %s\n",
+                option == 't' ? "threads" : "jobs", optarg);
+        return false;
+      }
+      (option == 't' ? options.threads : options.jobs) = integer;
+      break;
+    case OPTION_TABLE_MEMORY:
+      if (!parseInteger(optarg, integer) || integer < 0) {
+        fprintf(stderr, "--table-memory must be 0 or more, not %s\n", optarg);
+        return false;
+      }
+      options.tableMemory = integer;
+      break;
+    case OPTION_STREAM:
+      if (!parseInteger(optarg, integer) || integer < 1) {
+        fprintf(stderr, "--stream must be at least 1, not %s\n", optarg);
+        return false;
+      }
+      options.streamMemory = integer;
+      break;
+    case OPTION_SCRATCH:
+      options.scratch = optarg;
+      break;
+    case OPTION_IN_PLACE:
+      options.inPlace = true;
+      break;
+    case 'z':
+      if (!parseInteger(optarg, integer) || integer < PNG_MIN_COMPRESSION ||
+          integer > PNG_MAX_COMPRESSION) {
+        fprintf(stderr, "--compression must be between %d and %d, not %s\n",
+                PNG_MIN_COMPRESSION, PNG_MAX_COMPRESSION, optarg);
+        return false;
+      }
+      options.compression = integer;
+      break;
+    case 'h':
+      printUsage(stdout, argv[0]);
+      exit(EXIT_SUCCESS);
+    default:
+      return false;
+    }
+  }
+
+  if (optind < argc) {
+    fprintf(stderr, "Unexpected argument %s\n", argv[optind]);
+    return false;
+  }
+  if (options.inputs.empty() || options.output.empty()) {
+    fprintf(stderr, "Both --input and --output are required\n");
+    return false;
+  }
+  if (options.percentMin > options.percentMax) {
+    fprintf(stderr, "--min must not be more than --max\n");
+    return false;
+  }
+  return true;
+}
+
+// True if path has one of the SUPPORTED_IMAGE_TYPES extensions
+static bool isSupportedImage(const std::filesystem::path &path) {
+  std::string extension = path.extension().string();
+  std::transform(extension.begin(), extension.end(), extension.begin(),
+                 ::tolower);
+  for (const char *type : SUPPORTED_IMAGE_TYPES) {
+    if (extension == type) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Expand an input into the images it names. Directories give every supported
+// image directly inside them, anything else that is not a file is a glob
+static bool expandInput(const std::string &input,
+                        std::vector<std::string> &files) {
+  std::error_code error;
+  if (std::filesystem::is_directory(input, error)) {
+    std::vector<std::string> found;
+    for (const auto &entry :
+         std::filesystem::directory_iterator(input, error)) {
+      if (entry.is_regular_file(error) && isSupportedImage(entry.path())) {
+        found.push_back(entry.path().string());
+      }
+    }
+    if (error) {
+      fprintf(stderr, "Could not read directory %s: %s\n", input.c_str(),
+              error.message().c_str());
+      return false;
+    }
+    std::sort(found.begin(), found.end());
+    files.insert(files.end(), found.begin(), found.end());
+    return true;
+  }
+  if (std::filesystem::is_regular_file(input, error)) {
+    files.push_back(input);
+    return true;
+  }
+
+  glob_t matches;
+  int result = glob(input.c_str(), 0, NULL, &matches);
+  if (result != 0) {
+    fprintf(stderr, "No images match %s\n", input.c_str());
+    if (result != GLOB_NOMATCH) {
+      globfree(&matches);
+    }
+    return false;
+  }
+  for (size_t i = 0; i < matches.gl_pathc; i++) {
+    if (std::filesystem::is_regular_file(matches.gl_pathv[i], error)) {
+      files.push_back(matches.gl_pathv[i]);
+    }
+  }
+  globfree(&matches);
+  return true;
+}
+
+// Turn the inputs into the list of images to sort, and where each is saved
+static bool planTasks(const Options &options, std::vector<Task> &tasks) {
+  std::vector<std::string> files;
+  for (const std::string &input : options.inputs) {
+    if (!expandInput(input, files)) {
+      return false;
+    }
+  }
+  if (files.empty()) {
+    fprintf(stderr, "No images to sort\n");
+    return false;
+  }
+
+  std::error_code error;
+  bool toDirectory = files.size() > 1 ||
+                     std::filesystem::is_directory(options.output, error);
+  if (!toDirectory) {
+    tasks.push_back({files[0], options.output});
+    return true;
+  }
+
+  std::filesystem::create_directories(options.output, error);
+  if (error) {
+    fprintf(stderr, "Could not create directory %s: %s\n",
+            options.output.c_str(), error.message().c_str());
+    return false;
+  }
+  // Images are always saved as png
+  for (const std::string &file : files) {
+    std::filesystem::path output = std::filesystem::path(options.output) /
+                                   std::filesystem::path(file).filename();
+    output.replace_extension(".png");
+    tasks.push_back({file, output.string()});
+  }
+  return true;
+}
+
+// The angle to give the sorter for options.angle
+static double sorterAngle(const Options &options) {
+  // The GUI shows angles counter clockwise, the sorter takes them clockwise
+  return std::fmod(360 - options.angle, 360);
+}
+
+// Sort input into output, which is the same size and format, paged by paging
+// if it is not NULL. Returns false on failure
+static bool sortView(const ImageView &input, const ImageView &output,
+                     const Options &options, KeyPlane &keyPlane,
+                     SortWorkspace &workspace, ThreadPool *pool,
+                     const SortPaging *paging = NULL) {
+  // The image is new, so the key plane must not reuse old values
+  keyPlane.invalidate();
+  double angle = sorterAngle(options);
+  if (options.keyBits > 8) {
+    const PixelSorter_wideValue_t *keys =
+        quantizePixelsWide(*options.quantizer, keyPlane, input,
+                           options.keyBits, pool, NULL, paging);
+    return PixelSorter::sortImage(input, output, angle,
+                                  options.percentMin / 100,
+                                  options.percentMax / 100, keys,
+                                  options.keyBits, workspace, pool, NULL,
+                                  paging);
+  }
+  const PixelSorter_value_t *keys = quantizePixels(
+      *options.quantizer, keyPlane, input, pool, NULL, paging);
+  return PixelSorter::sortImage(input, output, angle, options.percentMin / 100,
+                                options.percentMax / 100, keys, workspace,
+                                pool, NULL, paging);
+}
+
+// Save image to path as the type its extension names, or otherwise as a png.
+// Returns false on failure
+static bool saveImage(const std::string &path, const ImageView &image,
+                      const Options &options, ThreadPool *pool) {
+  if (fastImageType(path) != FAST_IMAGE_NONE) {
+    return saveFastImage(path, image);
+  }
+  return savePng(path, image, options.compression, pool);
+}
+
+// Load, sort and save an image FastImageFile reads, in the format it is
+// loaded in so that no bits are lost. Returns false on failure
+static bool sortFastImage(const Task &task, const Options &options,
+                          KeyPlane &keyPlane, SortWorkspace &workspace,
+                          ThreadPool *pool) {
+  std::vector<uint8_t> inputPixels;
+  ImageView input;
+  if (!loadFastImage(task.input, inputPixels, input)) {
+    return false;
+  }
+  std::vector<uint8_t> outputPixels;
+  ImageView output = input;
+  if (!options.inPlace) {
+    outputPixels.resize(inputPixels.size());
+    output.pixels = outputPixels.data();
+  }
+  return sortView(input, output, options, keyPlane, workspace, pool) &&
+         saveImage(task.output, output, options, pool);
+}
+
+// Load, sort and save a png with 16 bits per channel, which SDL_image would
+// cut down to 8. Returns false on failure
+static bool sortDeepPng(const Task &task, const Options &options,
+                        KeyPlane &keyPlane, SortWorkspace &workspace,
+                        ThreadPool *pool) {
+  std::vector<PixelRGBA16> inputPixels;
+  ImageView input;
+  if (!loadDeepPng(task.input, inputPixels, input)) {
+    return false;
+  }
+  std::vector<PixelRGBA16> outputPixels;
+  ImageView output = input;
+  if (!options.inPlace) {
+    outputPixels.resize(inputPixels.size());
+    output.pixels = outputPixels.data();
+  }
+  return sortView(input, output, options, keyPlane, workspace, pool) &&
+         saveImage(task.output, output, options, pool);
+}
+
+// Sort a png whose lines are its rows a band at a time, through
+// pipelinePng, with the bands and their keys fitting in options.streamMemory
+// MiB. Returns false on failure
+static bool sortPipelined(const Task &task, const Options &options,
+                          const PngInfo &info, KeyPlane &keyPlane,
+                          SortWorkspace &workspace, ThreadPool *pool) {
+  size_t rowBytes =
+      (size_t)info.width *
+      (pixelFormatBytes(pngPixelFormat(info.deep)) +
+       (options.keyBits > 8 ? sizeof(PixelSorter_wideValue_t)
+                            : sizeof(PixelSorter_value_t)));
+  size_t bandRows =
+      ((size_t)options.streamMemory << 20) / (PIPELINE_BANDS * rowBytes);
+  bandRows = std::max<size_t>(1, std::min<size_t>(bandRows, STREAM_BAND_ROWS));
+  return pipelinePng(task.input, task.output, bandRows, options.compression,
+                     [&](const ImageView &band) {
+                       return sortView(band, band, options, keyPlane,
+                                       workspace, pool);
+                     });
+}
+
+// Sort a png through scratch files mapped into memory, keeping about
+// options.streamMemory MiB of them in memory at once. Returns false on failure
+static bool sortStreamed(const Task &task, const Options &options,
+                         KeyPlane &keyPlane, SortWorkspace &workspace,
+                         ThreadPool *pool) {
+  PngInfo info;
+  if (fastImageType(task.output) != FAST_IMAGE_NONE ||
+      !readPngInfo(task.input, info)) {
+    fprintf(stderr, "Only pngs can be streamed\n");
+    return false;
+  }
+  int width = info.width;
+  int height = info.height;
+  // Sorts along rows never need the whole image, unless the png is interlaced
+  const SortWorkspace::Line &line =
+      workspace.line(sorterAngle(options), width, height);
+  if (line.runs.numRuns() == 1 && line.runs.majorIsX && !info.interlaced) {
+    return sortPipelined(task, options, info, keyPlane, workspace, pool);
+  }
+  ImageView input;
+  input.width = width;
+  input.height = height;
+  input.format = pngPixelFormat(info.deep);
+  input.stride = width * pixelFormatBytes(input.format);
+  size_t imageBytes = (size_t)input.stride * height;
+  size_t keyBytes = (size_t)width * height *
+                    (options.keyBits > 8 ? sizeof(PixelSorter_wideValue_t)
+                                         : sizeof(PixelSorter_value_t));
+
+  std::string scratch = options.scratch;
+  if (scratch.empty()) {
+    scratch = std::filesystem::path(task.output).parent_path().string();
+  }
+  if (scratch.empty()) {
+    scratch = ".";
+  }
+  MappedFile inputFile;
+  MappedFile outputFile;
+  MappedFile keyFile;
+  if (!inputFile.create(scratch, imageBytes) ||
+      (!options.inPlace && !outputFile.create(scratch, imageBytes)) ||
+      !keyFile.create(scratch, keyBytes)) {
+    return false;
+  }
+  input.pixels = inputFile.data();
+  ImageView output = input;
+  if (!options.inPlace) {
+    output.pixels = outputFile.data();
+  }
+  MappedFile &sortedFile = options.inPlace ? inputFile : outputFile;
+
+  SortPaging paging;
+  paging.residentBytes = (size_t)options.streamMemory << 20;
+  paging.releasePages = [&]() {
+    inputFile.release();
+    outputFile.release();
+    keyFile.release();
+  };
+  // Rows are read and written in chunks that fit the budget, each dropped
+  // once the next one is done
+  int chunkRows = std::max<size_t>(1, paging.residentBytes / input.stride);
+  auto releaseRows = [&](MappedFile &file, int row) {
+    if ((row + 1) % chunkRows == 0) {
+      file.release((size_t)(row + 1 - chunkRows) * input.stride,
+                   (size_t)chunkRows * input.stride);
+    }
+  };
+  if (!readPng(task.input, input,
+               [&](int row) { releaseRows(inputFile, row); })) {
+    return false;
+  }
+  paging.releasePages();
+
+  keyPlane.useBuffer(keyFile.data(), keyFile.size());
+  bool sorted =
+      sortView(input, output, options, keyPlane, workspace, pool, &paging);
+  // The key file is about to be unmapped
+  keyPlane.useBuffer(NULL, 0);
+  paging.releasePages();
+  return sorted &&
+         writePng(task.output, output,
+                  [&](int row) { releaseRows(sortedFile, row); },
+                  options.compression);
+}
+
+// Load, sort and save a single image. Returns false on failure
+static bool sortFile(const Task &task, const Options &options,
+                     KeyPlane &keyPlane, SortWorkspace &workspace,
+                     ThreadPool *pool) {
+  if (options.streamMemory > 0) {
+    return sortStreamed(task, options, keyPlane, workspace, pool);
+  }
+  if (fastImageType(task.input) != FAST_IMAGE_NONE) {
+    return sortFastImage(task, options, keyPlane, workspace, pool);
+  }
+  if (isDeepPng(task.input)) {
+    return sortDeepPng(task, options, keyPlane, workspace, pool);
+  }
+  SDL_Surface *inputSurface = IMG_Load(task.input.c_str());
+  if (inputSurface == NULL) {
+    fprintf(stderr, "Could not load %s: %s\n", task.input.c_str(),
+            IMG_GetError());
+    return false;
+  }
+  // Convert to the format the sorter works in, unless it already understands
+  // the one loaded, as converting briefly takes a second copy of the image
+  ImageView input;
+  if (!imageViewOfSurface(inputSurface, input)) {
+    SDL_Surface *converted =
+        SDL_ConvertSurfaceFormat(inputSurface, DEFAULT_PIXEL_FORMAT, 0);
+    SDL_FreeSurface(inputSurface);
+    inputSurface = converted;
+  }
+  SDL_Surface *outputSurface = inputSurface;
+  if (inputSurface != NULL && !options.inPlace) {
+    outputSurface = SDL_CreateRGBSurfaceWithFormat(
+        0, inputSurface->w, inputSurface->h, DEFAULT_DEPTH,
+        inputSurface->format->format);
+  }
+  if (outputSurface == NULL) {
+    fprintf(stderr, "Could not convert %s: %s\n", task.input.c_str(),
+            SDL_GetError());
+    SDL_FreeSurface(inputSurface);
+    return false;
+  }
+
+  ImageView output;
+  imageViewOfSurface(inputSurface, input);
+  imageViewOfSurface(outputSurface, output);
+  bool sorted = sortView(input, output, options, keyPlane, workspace, pool);
+
+  bool saved = sorted && saveImage(task.output, output, options, pool);
+  if (outputSurface != inputSurface) {
+    SDL_FreeSurface(outputSurface);
+  }
+  SDL_FreeSurface(inputSurface);
+  return saved;
+}
+
+int main(int argc, char *argv[]) {
+  Options options;
+  if (!parseOptions(argc, argv, options)) {
+    printUsage(stderr, argv[0]);
+    return EXIT_FAILURE;
+  }
+  std::vector<Task> tasks;
+  if (!planTasks(options, tasks)) {
+    return EXIT_FAILURE;
+  }
+
+  // One image uses every core, many images are sorted one per core
+  int cores = ThreadPool::hardwareThreads();
+  int jobs = options.jobs;
+  if (jobs == 0) {
+    jobs = tasks.size() == 1 ? 1 : cores / std::max(1, options.threads);
+  }
+  jobs = std::max(1, jobs);
+  jobs = std::min<int>(jobs, tasks.size());
+  int threads = options.threads;
+  if (threads == 0) {
+    threads = std::max(1, cores / jobs);
+  }
+  ColorTable::setMemoryBudget((size_t)options.tableMemory << 20);
+
+  // Each job takes the next image until there are none left
+  std::atomic<size_t> nextTask{0};
+  std::atomic<int> failures{0};
+  auto runJob = [&]() {
+    KeyPlane keyPlane;
+    SortWorkspace workspace;
+    std::unique_ptr<ThreadPool> pool;
+    if (threads > 1) {
+      pool = std::make_unique<ThreadPool>(threads);
+    }
+    size_t index;
+    while ((index = nextTask++) < tasks.size()) {
+      if (!sortFile(tasks[index], options, keyPlane, workspace, pool.get())) {
+        failures++;
+      }
+    }
+  };
+  std::vector<std::thread> workers;
+  for (int i = 1; i < jobs; i++) {
+    workers.emplace_back(runJob);
+  }
+  runJob();
+  for (std::thread &worker : workers) {
+    worker.join();
+  }
+
+  if (failures > 0) {
+    fprintf(stderr, "%d of %zu images could not be sorted\n", failures.load(),
+            tasks.size());
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
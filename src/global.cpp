@@ -0,0 +1,5 @@
+#include "global.hpp"
+#include "SDL_pixels.h"
+
+// Definition of constants
+const uint32_t DEFAULT_PIXEL_FORMAT = SDL_PIXELFORMAT_ABGR8888;
@@ -8,15 +8,17 @@ extern const uint32_t DEFAULT_PIXEL_FORMAT; //
 // The default pixel depth (in bits)
 #define DEFAULT_DEPTH 8
 
-// The image types supported by this program
+// The image types supported by this program. .qoi, .pam and .rgba are loaded
+// and saved by FastImageFile, the rest by SDL_image and PngEncoder
 #define SUPPORTED_IMAGE_TYPES                                                  \
-  { ".png", ".jpg" }
+  { ".png", ".jpg", ".qoi", ".pam", ".rgba" }
 
 // Macro to convert from a 2d coordinates system to 1d
 #define TWOD_TO_1D(_x_, _y_, _w_) _x_ + (_y_ * _w_)
 
 // Returns the length of an array
-template <class Type, std::ptrdiff_t n> std::ptrdiff_t arrayLen(Type (&)[n]) {
+template <class Type, std::ptrdiff_t n>
+constexpr std::ptrdiff_t arrayLen(Type (&)[n]) {
   return n;
 }
 
@@ -1,8 +1,10 @@
 #include <algorithm>
+#include <cfloat>
 #include <cmath>
 #include <cstddef>
 #include <cstdint>
 #include <cstdlib>
+#include <memory>
 #include <stdio.h>
 #include <string>
 
@@ -22,82 +24,25 @@
 #include "imfilebrowser.h"
 
 // Local includes
-#include "ColorConversion.hpp"
+#include "ColorTable.hpp"
+#include "FastImageFile.hpp"
 #include "ImGui_SDL2_helpers.hpp"
-#include "LineCollision.hpp"
-#include "LineInterpolator.hpp"
 #include "PixelSorter.hpp"
+#include "PngEncoder.hpp"
+#include "Quantizers.hpp"
+#include "SortWorker.hpp"
+#include "SurfaceImageView.hpp"
+#include "ThreadPool.hpp"
 #include "global.hpp"
 
 #if !SDL_VERSION_ATLEAST(2, 0, 17)
 #error DearImGUI backend requires SDL 2.0.17+ because of SDL_RenderGeometry()
 #endif
 
-using LineCollision::pointQueue;
-
-// Definition of constants
-const uint32_t DEFAULT_PIXEL_FORMAT = SDL_PIXELFORMAT_ABGR8888;
-
-// Simple class, would be a struct, but constructors are nice
-class QuantizerOptionItem {
-public:
-  QuantizerOptionItem(ColorConverter *function, std::string name,
-                      std::string tooltip) {
-    this->function = function;
-    this->name = name;
-    this->tooltip = tooltip;
-  }
-  ColorConverter *function; // ColorConverter function this repersents
-  // Use char* instead of std::string as that is what DearImGui uses
-  // This removes a step every frame
-  std::string name;    // The name of this option (what is shown in the list)
-  std::string tooltip; // The tooltip that is displayed over the item
-};
-
-// The options that repersent the pixel quantizers.
-const QuantizerOptionItem quantizer_options[] = {
-    /*
-     * Organized by color spaces in this order:
-     * - RGB
-     * - HSV
-     * - HSL
-     * - Misc.
-     */
-    QuantizerOptionItem(&ColorConversion::red, "Red",
-                        "The R in RGB of the pixel"),
-    QuantizerOptionItem(&ColorConversion::green, "Green",
-                        "The G in RGB of the pixel"),
-    QuantizerOptionItem(&ColorConversion::blue, "Blue",
-                        "The B in RGB of the pixel"),
-    QuantizerOptionItem(&ColorConversion::hue, "Hue",
-                        "The color shade of a pixel.\nThe H in HSV and HSL"),
-    QuantizerOptionItem(
-        &ColorConversion::saturation, "Saturation (HSV)",
-        "How far from pure black a color appears to be.\nCalculated with the "
-        "HSV color space, it is subtly different from the HSL Saturation.\nThe "
-        "S in HSV"),
-    QuantizerOptionItem(
-        &ColorConversion::value, "Value",
-        "The maximum of the RGB values of the pixel.\nThe V in HSV."),
-    QuantizerOptionItem(
-        &ColorConversion::saturation_HSL, "Saturation (HSL)",
-        "How far from pure black a color appears to be.\nCalculated with the "
-        "HSL color space, it is subtly different from the HSV Saturation.\n"
-        "The S in HSL."),
-    QuantizerOptionItem(&ColorConversion::lightness, "Lightness",
-                        "How pale a color appears to be.\nThe L in HSL."),
-    QuantizerOptionItem(&ColorConversion::average, "Average",
-                        "The average of the RGB values of the pixel"),
-    QuantizerOptionItem(&ColorConversion::minimum, "Minimum",
-                        "The smallest of the RGB values of the pixel"),
-    QuantizerOptionItem(&ColorConversion::maximum, "Maximum",
-                        "The largest of the RGB values of the pixel"),
-    QuantizerOptionItem(&ColorConversion::chroma, "Chroma",
-                        "The difference between the maximum and minimum values "
-                        "of the RGB values of the pixel.\n Effectivly: how "
-                        "different a color is from the nearest gray")
-
-};
+// Longest side of the copy of the input sorted while settings are changing
+#define PREVIEW_MAX_SIDE 512
+// Seconds the settings must stay still before the full image is sorted
+#define PREVIEW_SETTLE_SECONDS 0.25
 
 // Scale source such that it takes up the most space it can within bounds.
 ImVec2 maximizeImVec2WithinBounds(const ImVec2 &source, const ImVec2 &bounds) {
@@ -189,76 +134,155 @@ void displayTiledZoomableImages(const ImGuiViewport *viewport,
   ImGui::EndChild();
 }
 
-// Wrapper for the PixelSorter::sort function, converts surfaces to pixel
-// arrays to pass onto it, and assembles some needed information
-bool sort_wrapper(SDL_Renderer *renderer, SDL_Surface *&inputSurface,
-                  SDL_Surface *&outputSurface, double angle, double valueMin,
-                  double valueMax, ColorConverter *converter) {
+// Wrapper for starting a sort on sortWorker, converts surfaces to image views
+// to pass onto it, and assembles some needed information. Returns NULL if the
+// sort could not be started
+std::shared_ptr<SortJob>
+sort_wrapper(SortWorker &sortWorker, SDL_Surface *&inputSurface,
+             SDL_Surface *&outputSurface, double angle, double valueMin,
+             double valueMax, const QuantizerOptionItem &quantizer,
+             int keyBits, int threadCount) {
   if (inputSurface == NULL || outputSurface == NULL) {
-    return false;
+    return NULL;
   }
-  // While I would rather cast and pass directly, must do this so that the
-  // compiler will stop complaining
-  PixelSorter_Pixel_t *inputPixels = (uint32_t *)inputSurface->pixels;
-  PixelSorter_Pixel_t *outputPixels = (uint32_t *)outputSurface->pixels;
-  // Generate the line
-  BresenhamsArguments bresenhamsArgs(0, 0);
-  pointQueue pointQueue = LineCollision::generateLineQueueForRect(
-      angle, inputSurface->w, inputSurface->h, bresenhamsArgs);
-  int numPoints = pointQueue.size();
-
-  // Convert point queue to array of points
-  point_ints *points =
-      (point_ints *)calloc(sizeof(point_ints), pointQueue.size());
-  if (points == NULL) {
-    fprintf(stderr, "Unable to convert point queue to array\n");
+  SortRequest request;
+  if (!imageViewOfSurface(inputSurface, request.input) ||
+      !imageViewOfSurface(outputSurface, request.output)) {
+    fprintf(stderr, "Can not sort images in this pixel format\n");
+    return NULL;
+  }
+  request.angle = angle;
+  request.valueMin = valueMin / 100;
+  request.valueMax = valueMax / 100;
+  request.quantizer = &quantizer;
+  request.keyBits = keyBits;
+  request.threadCount = threadCount;
+  return sortWorker.submit(request);
+}
+
+// A small copy of the input image, sorted on the GUI thread while the
+// settings are being dragged so that the output follows them at frame rate
+struct LivePreview {
+  SDL_Surface *input = NULL;
+  SDL_Surface *output = NULL;
+  KeyPlane keyPlane;
+  SortWorkspace workspace;
+
+  ~LivePreview() { reset(); }
+
+  // Forget the copy, must be called when the input image is replaced
+  void reset() {
+    SDL_FreeSurface(input);
+    SDL_FreeSurface(output);
+    input = NULL;
+    output = NULL;
+    keyPlane.invalidate();
+  }
+};
+
+// Sort the preview copy of inputSurface, and show it in outputTexture. The
+// texture is smaller than the output surface, but is displayed at its size.
+// Returns false if the preview could not be sorted
+bool sort_preview(LivePreview &preview, SDL_Renderer *renderer,
+                  SDL_Surface *inputSurface, SDL_Texture *&outputTexture,
+                  double angle, double valueMin, double valueMax,
+                  const QuantizerOptionItem &quantizer, int keyBits) {
+  if (inputSurface == NULL) {
     return false;
   }
-  for (int i = 0; i < numPoints && !pointQueue.empty(); i++) {
-    points[i] = pointQueue.front();
-    pointQueue.pop();
+  if (preview.input == NULL) {
+    preview.input = downscaleSurface(inputSurface, PREVIEW_MAX_SIDE);
+    if (preview.input == NULL) {
+      return false;
+    }
+    preview.output = SDL_CreateRGBSurfaceWithFormat(
+        0, preview.input->w, preview.input->h, DEFAULT_DEPTH,
+        preview.input->format->format);
+    if (preview.output == NULL) {
+      preview.reset();
+      return false;
+    }
   }
 
-  // Start and end coordinates for making multiple lines
-  int startX = 0;
-  int startY = 0;
-  int endX = 0;
-  int endY = 0;
-
-  // Shift to specific corner for each quadrant
-  if (angle >= 0 && angle < 90) { // +x +y quadrant
-    startX = 0;
-    startY = 0;
-  } else if (angle >= 90 && angle < 180) { // -x +y quadrant
-    startX = inputSurface->w - 1;
-    startY = 0;
-  } else if (angle >= 180 && angle < 270) { // -x -y quadrant
-    startX = inputSurface->w - 1;
-    startY = inputSurface->h - 1;
-  } else { // +x -y quadrant
-    startX = 0;
-    startY = inputSurface->h - 1;
+  ImageView input;
+  ImageView output;
+  if (!imageViewOfSurface(preview.input, input) ||
+      !imageViewOfSurface(preview.output, output)) {
+    return false;
   }
-  // Properly set endX and endY
-  endX = bresenhamsArgs.deltaX + startX;
-  endY = bresenhamsArgs.deltaY + startY;
-
-  PixelSorter::sort(inputPixels, outputPixels, points, numPoints,
-                    inputSurface->w, inputSurface->h, startX, startY, endX,
-                    endY, valueMin / 100, valueMax / 100, converter,
-                    inputSurface->format);
-  free(points);
+  // Small enough to sort on this thread, a pool would only add latency
+  if (keyBits > 8) {
+    const PixelSorter_wideValue_t *keys =
+        quantizePixelsWide(quantizer, preview.keyPlane, input, keyBits);
+    if (keys == NULL ||
+        !PixelSorter::sortImage(input, output, angle, valueMin / 100,
+                                valueMax / 100, keys, keyBits,
+                                preview.workspace)) {
+      return false;
+    }
+  } else {
+    const PixelSorter_value_t *keys =
+        quantizePixels(quantizer, preview.keyPlane, input);
+    if (keys == NULL ||
+        !PixelSorter::sortImage(input, output, angle, valueMin / 100,
+                                valueMax / 100, keys, preview.workspace)) {
+      return false;
+    }
+  }
+  outputTexture = updateTexture(renderer, preview.output, outputTexture);
   return true;
 }
 
+// Load the image at path into a new surface. SDL_image loads most types, and
+// FastImageFile the ones it does not know. Returns NULL on failure
+SDL_Surface *loadImage(const std::string &path) {
+  if (fastImageType(path) == FAST_IMAGE_NONE) {
+    return IMG_Load(path.c_str());
+  }
+  std::vector<uint8_t> pixels;
+  ImageView image;
+  if (!loadFastImage(path, pixels, image)) {
+    return NULL;
+  }
+  // Surfaces only have 8 bits per channel
+  SDL_Surface *surface =
+      SDL_CreateRGBSurfaceWithFormat(0, image.width, image.height,
+                                     DEFAULT_DEPTH, SDL_PIXELFORMAT_ABGR8888);
+  ImageView view;
+  if (surface != NULL && imageViewOfSurface(surface, view)) {
+    convertToABGR8888(image, view);
+  }
+  return surface;
+}
+
+// Save surface to path as the type its extension names, or otherwise as a
+// png compressed at pngCompression. Returns false on failure
+bool exportImage(SDL_Surface *surface, const std::string &path,
+                 int pngCompression) {
+  ImageView image;
+  if (!imageViewOfSurface(surface, image)) {
+    fprintf(stderr, "Can not save images in this pixel format\n");
+    return false;
+  }
+  if (fastImageType(path) != FAST_IMAGE_NONE) {
+    return saveFastImage(path, image);
+  }
+  // Deflated on every core, the window waits for the export either way
+  ThreadPool pool;
+  return savePng(path, image, pngCompression, &pool);
+}
+
 // Forward declerations
 int mainWindow(const ImGuiViewport *viewport, SDL_Renderer *renderer,
                SDL_Surface *&inputSurface, SDL_Texture *&inputTexture,
                SDL_Surface *&outputSurface, SDL_Texture *&outputTexture,
-               std::filesystem::path *output_path, ColorConverter **converter);
+               std::filesystem::path *output_path,
+               const QuantizerOptionItem **quantizer, SortWorker &sortWorker,
+               LivePreview &preview);
 
 void handleMainMenuBar(ImGui::FileBrowser &inputFileDialog,
-                       ImGui::FileBrowser &outputFileDialog);
+                       ImGui::FileBrowser &outputFileDialog,
+                       int &pngCompression);
 
 int main(int, char **) {
   // Setup SDL
@@ -342,7 +366,13 @@ int main(int, char **) {
   SDL_Texture *inputTexture = NULL;
   SDL_Texture *outputTexture = NULL;
 
-  ColorConverter *converter = &(ColorConversion::average);
+  const QuantizerOptionItem *quantizer = &quantizer_options[0];
+  // Sorts in the background, and keeps the value of each pixel of
+  // inputSurface between sorts
+  SortWorker sortWorker;
+  LivePreview preview;
+  // zlib level exported pngs are compressed at
+  int pngCompression = PNG_DEFAULT_COMPRESSION;
 
   bool done = false;
   /* === START OF MAIN LOOP ================================================= */
@@ -366,13 +396,15 @@ int main(int, char **) {
 
     const ImGuiViewport *viewport = ImGui::GetMainViewport();
     mainWindow(viewport, renderer, inputSurface, inputTexture, outputSurface,
-               outputTexture, NULL, &converter);
-    handleMainMenuBar(inputFileDialog, outputFileDialog);
+               outputTexture, NULL, &quantizer, sortWorker, preview);
+    handleMainMenuBar(inputFileDialog, outputFileDialog, pngCompression);
 
     // Process input file dialog
     inputFileDialog.Display();
     if (inputFileDialog.HasSelected()) {
-      inputSurface = IMG_Load(inputFileDialog.GetSelected().c_str());
+      // The surfaces are about to be replaced, stop sorting them
+      sortWorker.cancelAndWait();
+      inputSurface = loadImage(inputFileDialog.GetSelected().string());
       if (inputSurface == NULL) {
         // TODO cancel file browser exit on error
         fprintf(stderr, "File %s does not exist\n",
@@ -381,6 +413,9 @@ int main(int, char **) {
         // Immediately convert to the basic format
         inputSurface = SDL_ConvertSurfaceFormat_MemSafe(inputSurface,
                                                         DEFAULT_PIXEL_FORMAT);
+        // The cached values belong to the old image
+        sortWorker.invalidateKeys();
+        preview.reset();
         // Convert to texture
         inputTexture = updateTexture(renderer, inputSurface, inputTexture);
         // Create the output surface to use with this
@@ -400,8 +435,10 @@ int main(int, char **) {
     outputFileDialog.Display();
     if (outputFileDialog.HasSelected()) {
       outputPath = outputFileDialog.GetSelected();
+      // Let the sort in progress finish before saving its output
+      sortWorker.wait();
       if (outputSurface != NULL) {
-        IMG_SavePNG(outputSurface, outputPath.c_str());
+        exportImage(outputSurface, outputPath.string(), pngCompression);
       } else {
         fprintf(stderr, "The output image does not exist! You must sort before "
                         "exporting!\n");
@@ -427,7 +464,8 @@ int main(int, char **) {
 
 // Handle the main menu bar
 void handleMainMenuBar(ImGui::FileBrowser &inputFileDialog,
-                       ImGui::FileBrowser &outputFileDialog) {
+                       ImGui::FileBrowser &outputFileDialog,
+                       int &pngCompression) {
   if (ImGui::BeginMainMenuBar()) {
     if (ImGui::BeginMenu("File")) {
       ImGui::SeparatorText("Image files");
@@ -438,6 +476,12 @@ void handleMainMenuBar(ImGui::FileBrowser &inputFileDialog,
       if (ImGui::MenuItem("Export as", "", false)) {
         outputFileDialog.Open();
       }
+      ImGui::SliderInt("##PNG compression", &pngCompression,
+                       PNG_MIN_COMPRESSION, PNG_MAX_COMPRESSION,
+                       "PNG compression: %d", ImGuiSliderFlags_AlwaysClamp);
+      ImGui::SetItemTooltip("How hard exported pngs are compressed.\n"
+                            "0 is fastest, 9 is smallest. For the fastest "
+                            "exports,\nsave as .qoi, .pam or .rgba instead");
       ImGui::EndMenu();
     }
   }
@@ -449,7 +493,9 @@ void handleMainMenuBar(ImGui::FileBrowser &inputFileDialog,
 int mainWindow(const ImGuiViewport *viewport, SDL_Renderer *renderer,
                SDL_Surface *&inputSurface, SDL_Texture *&inputTexture,
                SDL_Surface *&outputSurface, SDL_Texture *&outputTexture,
-               std::filesystem::path *outputPath, ColorConverter **converter) {
+               std::filesystem::path *outputPath,
+               const QuantizerOptionItem **quantizer, SortWorker &sortWorker,
+               LivePreview &preview) {
   static ImGuiWindowFlags windowFlags =
       ImGuiWindowFlags_NoCollapse | ImGuiWindowFlags_NoSavedSettings |
       ImGuiWindowFlags_NoResize | ImGuiWindowFlags_NoTitleBar;
@@ -464,6 +510,8 @@ int mainWindow(const ImGuiViewport *viewport, SDL_Renderer *renderer,
     static float angle = 0;
     static float percentMin = 25.0;
     static float percentMax = 75.0;
+    // Set when any setting that changes the sorted image is changed
+    bool settingsChanged = false;
 
     /* === Top options, sorting. ============================================ */
     static ImGuiTableFlags table_flags =
@@ -478,7 +526,7 @@ int mainWindow(const ImGuiViewport *viewport, SDL_Renderer *renderer,
       static int selected_index = 7; // TODO: Use lightness as default
       /* Pixel quantizer selection */
       {
-        static const int quantizers_count = arrayLen(quantizer_options);
+        static const int quantizers_count = quantizer_options_count;
 
         // Pass in the preview value visible before opening the combo
         const char *preview_value =
@@ -490,42 +538,109 @@ int mainWindow(const ImGuiViewport *viewport, SDL_Renderer *renderer,
           for (int n = 0; n < quantizers_count; n++) {
             const bool is_selected = (selected_index == n);
             if (ImGui::Selectable(quantizer_options[n].name.c_str(),
-                                  is_selected))
+                                  is_selected)) {
+              settingsChanged = selected_index != n;
               selected_index = n; // Update selected
+            }
             if (is_selected) // Set the initial focus when opening the combo
               ImGui::SetItemDefaultFocus();
             ImGui::SetItemTooltip("%s", quantizer_options[n].tooltip.c_str());
           }
           ImGui::EndCombo();
         }
-        *converter = quantizer_options[selected_index].function; // update
+        *quantizer = &quantizer_options[selected_index]; // update
       }
       ImGui::SetItemTooltip(
           "The value that each pixel in the image will be converted to and "
           "then sorted by.\nDefault is lightness");
 
+      /* Precision of the values sorted by */
+      static const int keyBitsOptions[] = {8, 12, 16};
+      static int keyBitsIndex = 0;
+      ImGui::SameLine();
+      ImGui::SetNextItemWidth(ImGui::GetFontSize() * 6);
+      if (ImGui::Combo("##Key bits", &keyBitsIndex,
+                       "8 bit\0" "12 bit\0" "16 bit\0")) {
+        settingsChanged = true;
+      }
+      ImGui::SetItemTooltip(
+          "How finely each value is measured. More bits keep smooth\n"
+          "gradients in order, but sorting takes longer.\nDefault is 8 bit");
+      const int keyBits = keyBitsOptions[keyBitsIndex];
+
       const ImGuiSliderFlags sliderFlags = ImGuiSliderFlags_AlwaysClamp;
 
       ImGui::Text("In the range ");
       ImGui::SameLine();
       // Set the minimum and maximum percentages of values will be sorted
-      ImGui::DragFloatRange2("##Percentage range", &percentMin, &percentMax,
-                             1.0f, 0.0f, 100.0f, "Minimum: %.2f%%",
-                             "Maximum: %.2f%%", sliderFlags);
+      if (ImGui::DragFloatRange2("##Percentage range", &percentMin,
+                                 &percentMax, 1.0f, 0.0f, 100.0f,
+                                 "Minimum: %.2f%%", "Maximum: %.2f%%",
+                                 sliderFlags)) {
+        settingsChanged = true;
+      }
       ImGui::SetItemTooltip("The image will be sorted by %s that is\nin the "
                             "range %.2f to %.2f (inclusive).\nThese sliders "
                             "control the minimum and maximum of that range",
                             quantizer_options[selected_index].name.c_str(),
                             percentMin, percentMax);
 
+      /* Number of threads to sort with */
+      static int threadCount = ThreadPool::hardwareThreads();
+      ImGui::SliderInt("##Threads", &threadCount, 1,
+                       ThreadPool::hardwareThreads(), "Threads: %d",
+                       sliderFlags);
+      ImGui::SetItemTooltip("How many threads the image is sorted with.\n"
+                            "Default is one per core");
+
+      /* Memory budget for color lookup tables */
+      static int tableBudget = 0; // In MiB
+      if (ImGui::SliderInt("##Table memory", &tableBudget, 0, 256,
+                           "Lookup tables: %d MiB", sliderFlags)) {
+        ColorTable::setMemoryBudget((size_t)tableBudget << 20);
+      }
+      ImGui::SetItemTooltip(
+          "Memory that lookup tables for Hue, Saturation and Lightness may "
+          "use.\nEach table takes 16 MiB and makes converting those values "
+          "much\nfaster. Tables are saved to disk to be reused.\n"
+          "0 turns lookup tables off");
+
       /* Sorting button. Enabled only when there is an input surface */
+      // The sort running in the background, if any
+      static std::shared_ptr<SortJob> sortJob;
+      // Preview sorts while settings change, then sort the full image
+      static bool livePreview = true;
+      // The preview is showing, and the full image still needs sorting
+      static bool previewPending = false;
+      static double lastChange = 0; // When settingsChanged was last set
       ImGui::BeginDisabled(inputSurface == NULL);
       if (ImGui::Button("Sort")) {
-        sort_wrapper(renderer, inputSurface, outputSurface, angle, percentMin,
-                     percentMax, *converter);
-        outputTexture = updateTexture(renderer, outputSurface, outputTexture);
+        // Replaces the sort in progress
+        sortJob = sort_wrapper(sortWorker, inputSurface, outputSurface, angle,
+                               percentMin, percentMax, **quantizer, keyBits,
+                               threadCount);
+        previewPending = false;
       }
       ImGui::EndDisabled();
+      ImGui::SameLine();
+      ImGui::Checkbox("Live preview", &livePreview);
+      ImGui::SetItemTooltip(
+          "Sort a smaller copy of the image while the settings are being "
+          "changed,\nthen sort the full image once they stop changing");
+      if (sortJob != nullptr && !sortJob->isDone()) {
+        ImGui::SameLine();
+        if (ImGui::Button("Cancel")) {
+          sortJob->cancel();
+        }
+        ImGui::SameLine();
+        ImGui::ProgressBar(sortJob->progress(), ImVec2(-FLT_MIN, 0));
+      } else if (sortJob != nullptr) {
+        // Show the sorted image once the sort is done
+        if (sortJob->state() == SortJob::FINISHED) {
+          outputTexture = updateTexture(renderer, outputSurface, outputTexture);
+        }
+        sortJob = nullptr;
+      }
 
       /* === End of left half =============================================== */
       ImGui::TableSetColumnIndex(column_id++);
@@ -550,6 +665,7 @@ int mainWindow(const ImGuiViewport *viewport, SDL_Renderer *renderer,
         // Knob has caused a change, update the angle
         angle = RAD_TO_DEG(knob_angle);
         std::clamp(angle, low_rd, high_r);
+        settingsChanged = true;
       }
       ImGui::SetItemTooltip("%s", tooltip.c_str());
 
@@ -562,9 +678,31 @@ int mainWindow(const ImGuiViewport *viewport, SDL_Renderer *renderer,
         // change in the display angle
         angle = (360 - displayAngle);
         std::clamp(angle, low_rd, high_d);
+        settingsChanged = true;
       }
       ImGui::SetItemTooltip("%s\nControl Left click to enter an angle.",
                             tooltip.c_str());
+
+      /* === Live preview =================================================== */
+      if (settingsChanged && livePreview && inputSurface != NULL) {
+        // The full sort would be out of date, and would replace the preview
+        if (sortJob != nullptr) {
+          sortJob->cancel();
+          sortJob = nullptr;
+        }
+        sort_preview(preview, renderer, inputSurface, outputTexture, angle,
+                     percentMin, percentMax, **quantizer, keyBits);
+        previewPending = true;
+        lastChange = ImGui::GetTime();
+      }
+      // Sort the full image once the controls are let go, and have settled
+      if (previewPending && !ImGui::IsAnyItemActive() &&
+          ImGui::GetTime() - lastChange >= PREVIEW_SETTLE_SECONDS) {
+        sortJob = sort_wrapper(sortWorker, inputSurface, outputSurface, angle,
+                               percentMin, percentMax, **quantizer, keyBits,
+                               threadCount);
+        previewPending = false;
+      }
     }
     /* === End of angle options ============================================= */
     ImGui::EndTable();